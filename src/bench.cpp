@@ -1,17 +1,40 @@
 #include "bench.hpp"
 #include "board.hpp"
+#include "cache.hpp"
+#include "gen.hpp"
 #include "header.hpp"
 #include "movegen.hpp"
+#include "packed.hpp"
+#include "pc.hpp"
+#include "reference.hpp"
+#include "search.hpp"
+#include "stats.hpp"
+#include "thread.hpp"
+#include "tt.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <istream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace Cobra {
 
 uint64_t perft(State& state, const Piece* next, unsigned depth) {
     if (depth == 1)
-        return static_cast<uint64_t>(MoveList(state.board, *next).size());
+        return static_cast<uint64_t>(count_moves(state.board, *next));
 
     uint64_t nodes = 0;
     for (const Move& move : MoveList(state.board, *next)) {
@@ -23,24 +46,1874 @@ uint64_t perft(State& state, const Piece* next, unsigned depth) {
     return nodes;
 }
 
-void bench_perft() {
-    // Depth should be <= the queue size, but that is left to the user
-    constexpr unsigned depth = 7;
-    const Piece queue[] = {I, O, L, J, S, Z, T};
-    State state;
+uint64_t perft_undo(State& state, const Piece* next, unsigned depth) {
+    if (depth == 1)
+        return static_cast<uint64_t>(count_moves(state.board, *next));
+
+    uint64_t nodes = 0;
+    UndoInfo undo;
+    for (const Move& move : MoveList(state.board, *next)) {
+        state.do_move(move, undo);
+        nodes += perft_undo(state, next + 1, depth - 1);
+        state.undo_move(undo);
+    }
+
+    return nodes;
+}
+
+uint64_t perft_arena(State& state, const Piece* next, unsigned depth, MoveStack& stack) {
+    if (depth == 1)
+        return static_cast<uint64_t>(count_moves(state.board, *next));
+
+    uint64_t nodes = 0;
+    UndoInfo undo;
+    const MoveSpan moves = stack.push(state.board, *next);
+    for (const Move& move : moves) {
+        state.do_move(move, undo);
+        nodes += perft_arena(state, next + 1, depth - 1, stack);
+        state.undo_move(undo);
+    }
+    stack.pop(moves);
+
+    return nodes;
+}
+
+uint64_t perft_cached(State& state, const Piece* next, unsigned depth, MoveCache& cache) {
+    if (depth == 1)
+        return static_cast<uint64_t>(cache.count_moves(state.board, *next));
+
+    uint64_t nodes = 0;
+    Move moves[MAX_MOVES];
+    Move* const last = cache.generate(state.board, moves, *next);
+    for (const Move* m = moves; m != last; ++m) {
+        State nextState = state;
+        nextState.do_move(*m);
+        nodes += perft_cached(nextState, next + 1, depth - 1, cache);
+    }
+
+    return nodes;
+}
+
+uint64_t perft_narrow(NarrowState& state, const Piece* next, unsigned depth) {
+    if (depth == 1)
+        return static_cast<uint64_t>(count_moves(state.board, *next));
+
+    uint64_t nodes = 0;
+    Move moves[MAX_MOVES];
+    Move* const last = generate(state.board, moves, *next, false);
+    for (const Move* m = moves; m != last; ++m) {
+        if (!state.fits(*m)) {
+            State wide;
+            wide.set(state);
+            wide.do_move(*m);
+            nodes += perft(wide, next + 1, depth - 1);
+            continue;
+        }
+        NarrowState nextState = state;
+        nextState.do_move(*m);
+        nodes += perft_narrow(nextState, next + 1, depth - 1);
+    }
+
+    return nodes;
+}
+
+// Key of the board and hold only: b2b and combo change no move list, so
+// subtrees differing in them have the same count
+static Key perft_key(const State& state) {
+    return state.key ^ Zobrist::b2b(state.b2b) ^ Zobrist::combo(state.combo);
+}
+
+static Key queue_key(const Piece* next, const unsigned depth) {
+    Key k = 0;
+    for (unsigned i = 0; i < depth; ++i)
+        k ^= Zobrist::queue(static_cast<int>(i), next[i]);
+    return k;
+}
+
+uint64_t perft_unique(State& state, const Piece* next, unsigned depth, PerftStats& stats) {
+    const MoveList moves(state, *next, prefer_spin);
+    ++stats.lists;
+    stats.pruned += moves.pruned();
+    if (depth == 1)
+        return moves.size();
+
+    uint64_t nodes = 0;
+    for (const Move& move : moves) {
+        State nextState = state;
+        nextState.do_move(move);
+        nodes += perft_unique(nextState, next + 1, depth - 1, stats);
+    }
+
+    return nodes;
+}
+
+uint64_t perft_tt(State& state, const Piece* next, unsigned depth, TranspositionTable& tt, PerftStats& stats) {
+    // Leaves are a single generate() call and transpose too rarely to pay for a probe
+    if (depth == 1)
+        return static_cast<uint64_t>(count_moves(state.board, *next));
+
+    // The queue suffix is part of the key, so one table can serve several queues
+    const Key key = perft_key(state) ^ queue_key(next, depth);
+    uint64_t nodes = 0;
+
+    ++stats.probes;
+    if (tt.probe(key, nodes)) {
+        ++stats.hits;
+        return nodes;
+    }
+
+    for (const Move& move : MoveList(state.board, *next)) {
+        State nextState = state;
+        nextState.do_move(move);
+        nodes += perft_tt(nextState, next + 1, depth - 1, tt, stats);
+    }
+
+    tt.store(key, nodes);
+    return nodes;
+}
+
+// Calls f(child, queue) for every child reachable with hold, queue being the
+// first piece left to play in the child
+template<typename F>
+static void for_each_hold_child(const State& state, const Piece* next, const Piece* last, F&& f) {
+    const Piece current = *next;
+    auto play = [&](const Move& move, const bool held, const Piece* queue) {
+        State child = state;
+        if (held)
+            child.set_hold(current);
+        child.do_move(move);
+        f(child, queue);
+    };
+
+    if (state.hold != NO_PIECE) {
+        // With current == hold the second piece is skipped, swapping would give the same child
+        for (const Move& move : HoldMoveList(state.board, current, state.hold))
+            play(move, move.piece() != current, next + 1);
+        return;
+    }
+
+    const MoveList moves(state.board, current);
+    for (const Move& move : moves)
+        play(move, false, next + 1);
+
+    // Holding into an empty slot plays the following piece and consumes it too
+    if (moves.empty() || next + 1 == last)
+        return;
+    if (next[1] == current)
+        for (const Move& move : moves)
+            play(move, true, next + 2);
+    else
+        for (const Move& move : MoveList(state.board, next[1]))
+            play(move, true, next + 2);
+}
+
+// Calls f(moves, queue, held) for the unique move lists of every hold choice,
+// queue being the first piece left after them and held whether every move
+// swaps into the hold slot. A move of another piece than the current one
+// always comes from hold. Follows for_each_hold_child, including no hold when
+// the current piece has no move, so only the de-duplication differs.
+template<typename F>
+static void for_each_unique_hold_list(const State& state, const Piece* next, const Piece* last, F&& f) {
+    const Piece current = *next;
+    if (state.hold != NO_PIECE) {
+        const HoldMoveList moves(state, current, state.hold, prefer_spin);
+        // No current move left means none was generated or, rarely, all of them
+        // collapsed into hold moves; the recount tells the two apart
+        const bool stuck = current != state.hold
+                        && std::none_of(moves.begin(), moves.end(), [current](const Move& m) { return m.piece() == current; })
+                        && !count_moves(state.board, current);
+        if (!stuck)
+            f(moves, next + 1, false);
+        return;
+    }
+
+    const MoveList moves(state, current, prefer_spin);
+    f(moves, next + 1, false);
+    if (!moves.empty() && next + 1 < last)
+        f(MoveList(state, next[1], prefer_spin), next + 2, true);
+}
+
+static State unique_hold_child(const State& state, const Piece current, const Move& move, const bool held) {
+    State child = state;
+    if (held || move.piece() != current)
+        child.set_hold(current);
+    child.do_move(move);
+    return child;
+}
+
+uint64_t perft_unique_hold(State& state, const Piece* next, const Piece* last, unsigned depth, PerftStats& stats) {
+    assert(next < last);
+    uint64_t nodes = 0;
+    for_each_unique_hold_list(state, next, last, [&](const auto& moves, const Piece* queue, const bool held) {
+        ++stats.lists;
+        stats.pruned += moves.pruned();
+        if (depth == 1) {
+            nodes += moves.size();
+            return;
+        }
+        if (queue == last)
+            return;
+        for (const Move& move : moves) {
+            State child = unique_hold_child(state, *next, move, held);
+            nodes += perft_unique_hold(child, queue, last, depth - 1, stats);
+        }
+    });
+    return nodes;
+}
+
+static uint64_t count_hold_leaves(const State& state, const Piece* next, const Piece* last) {
+    const Piece current = *next;
+    const size_t n = count_moves(state.board, current);
+    if (!n)
+        return 0;
+
+    if (state.hold != NO_PIECE)
+        return n + (state.hold != current ? count_moves(state.board, state.hold) : 0);
+    if (next + 1 == last)
+        return n;
+    return n + (next[1] == current ? n : count_moves(state.board, next[1]));
+}
+
+uint64_t perft_hold(State& state, const Piece* next, const Piece* last, unsigned depth,
+                    TranspositionTable* tt, PerftStats& stats) {
+    assert(next < last);
+    if (depth == 1)
+        return count_hold_leaves(state, next, last);
+
+    // A subtree reads at most depth + 1 queue pieces, the depth term separates
+    // windows truncated by the end of the queue
+    const unsigned window = std::min(depth + 1, static_cast<unsigned>(last - next));
+    const Key key = perft_key(state) ^ queue_key(next, window) ^ Zobrist::mix(depth);
+    uint64_t nodes = 0;
+
+    if (tt) {
+        ++stats.probes;
+        if (tt->probe(key, nodes)) {
+            ++stats.hits;
+            return nodes;
+        }
+    }
+
+    for_each_hold_child(state, next, last, [&](State& child, const Piece* queue) {
+        if (queue < last)
+            nodes += perft_hold(child, queue, last, depth - 1, tt, stats);
+    });
+
+    if (tt)
+        tt->store(key, nodes);
+    return nodes;
+}
+
+static uint64_t perft_run(State& state, const Piece* next, const Piece* last, const unsigned depth,
+                          const PerftOptions& options, TranspositionTable* tt, PerftStats& stats) {
+    if (options.hold)
+        return options.mode == UNIQUE && !tt ? perft_unique_hold(state, next, last, depth, stats)
+                                             : perft_hold(state, next, last, depth, tt, stats);
+    if (tt)
+        return perft_tt(state, next, depth, *tt, stats);
+    switch (options.mode) {
+        case MAKE_UNMAKE: return perft_undo(state, next, depth);
+        case ARENA:
+            {
+                thread_local MoveStack stack;
+                return perft_arena(state, next, depth, stack);
+            }
+        case CACHED:
+            {
+                thread_local MoveCache cache;
+                cache.share(options.cache);
+                return perft_cached(state, next, depth, cache);
+            }
+        case UNIQUE: return perft_unique(state, next, depth, stats);
+        case NARROW:
+            {
+                NarrowState narrow;
+                return narrow.set(state) ? perft_narrow(narrow, next, depth) : perft(state, next, depth);
+            }
+        default: return perft(state, next, depth);
+    }
+}
+
+struct alignas(64) NodeCounter {
+    uint64_t nodes;
+    PerftStats stats;
+};
+
+static void perft_split(ThreadPool& pool, const State& state, const Piece* next, const Piece* last,
+                        const unsigned depth, const unsigned splitDepth, const PerftOptions& options,
+                        TranspositionTable* tt, std::vector<NodeCounter>& counters) {
+    if (!splitDepth || depth == 1) {
+        pool.submit([&counters, &options, s = state, next, last, depth, tt](const size_t id) mutable {
+            counters[id].nodes += perft_run(s, next, last, depth, options, tt, counters[id].stats);
+        });
+        return;
+    }
+
+    if (options.hold && options.mode == UNIQUE && !tt)
+        for_each_unique_hold_list(state, next, last, [&](const auto& moves, const Piece* queue, const bool held) {
+            if (queue < last)
+                for (const Move& move : moves)
+                    perft_split(pool, unique_hold_child(state, *next, move, held), queue, last,
+                                depth - 1, splitDepth - 1, options, tt, counters);
+        });
+    else if (options.hold)
+        for_each_hold_child(state, next, last, [&](const State& child, const Piece* queue) {
+            if (queue < last)
+                perft_split(pool, child, queue, last, depth - 1, splitDepth - 1, options, tt, counters);
+        });
+    else {
+        // Unique mode counts Lists and Pruned below the split plies only
+        auto split = [&](const MoveList& moves) {
+            for (const Move& move : moves) {
+                State nextState = state;
+                nextState.do_move(move);
+                perft_split(pool, nextState, next + 1, last, depth - 1, splitDepth - 1, options, tt, counters);
+            }
+        };
+        if (options.mode == UNIQUE)
+            split(MoveList(state, *next, prefer_spin));
+        else
+            split(MoveList(state.board, *next));
+    }
+}
+
+uint64_t perft_parallel(const State& state, const Piece* next, const Piece* last, const PerftOptions& options,
+                        TranspositionTable* tt, std::vector<uint64_t>& threadNodes, PerftStats& stats) {
+    assert(options.depth > 0);
+    std::vector<NodeCounter> counters(options.threads, NodeCounter{});
+    {
+        ThreadPool pool(options.threads);
+        perft_split(pool, state, next, last, options.depth, options.splitDepth, options, tt, counters);
+        pool.wait();
+    }
+
+    uint64_t nodes = 0;
+    threadNodes.clear();
+    for (const auto& c : counters) {
+        threadNodes.push_back(c.nodes);
+        nodes += c.nodes;
+        stats.probes += c.stats.probes;
+        stats.hits += c.stats.hits;
+        stats.lists += c.stats.lists;
+        stats.pruned += c.stats.pruned;
+    }
+    return nodes;
+}
+
+// Position in the 7-bag sequence: pieces dealt from the current bag and how many it still holds
+struct Bag {
+    unsigned used;
+    unsigned left;
+
+    static Bag after(const unsigned offset) {
+        assert(offset < PIECE_NB);
+        return {0, PIECE_NB - offset};
+    }
+
+    bool allows(const Piece p) const { return !(used & (1U << p)); }
+    unsigned choices() const { return PIECE_NB - static_cast<unsigned>(popcount(used)); }
+
+    Bag deal(const Piece p) const {
+        assert(allows(p) && left);
+        return left == 1 ? Bag{0, PIECE_NB} : Bag{used | 1U << p, left - 1};
+    }
+
+    // Queues of depth pieces from here. Every choice leads to as many, so the
+    // queues after the i-th allowed piece are a contiguous block in lexicographic order.
+    size_t queues(const unsigned depth) const {
+        return depth ? choices() * deal(first()).queues(depth - 1) : 1;
+    }
+
+    Piece first() const {
+        return static_cast<Piece>(ctz(~used & ALL_PIECES));
+    }
+};
+
+// Adds the nodes of each queue below the prefix leading to state to counts
+static uint64_t perft_bag_walk(const State& state, const Bag bag, const unsigned depth, uint64_t* counts) {
+    const size_t stride = bag.deal(bag.first()).queues(depth - 1);
+    uint64_t nodes = 0;
+    for (Piece p = I; p < PIECE_NB; p = static_cast<Piece>(p + 1)) {
+        if (!bag.allows(p))
+            continue;
+
+        if (depth == 1) {
+            const uint64_t n = count_moves(state.board, p);
+            *counts += n;
+            nodes += n;
+        }
+        else
+            for (const Move& move : MoveList(state.board, p)) {
+                State nextState = state;
+                nextState.do_move(move);
+                nodes += perft_bag_walk(nextState, bag.deal(p), depth - 1, counts);
+            }
+        counts += stride;
+    }
+    return nodes;
+}
+
+// Per-thread counts, summed once the pool is done: subtrees under the same
+// prefix add to the same queues
+struct alignas(64) BagCounter {
+    uint64_t nodes;
+    std::vector<uint64_t> counts;
+};
+
+static void perft_bag_split(ThreadPool& pool, const State& state, const Bag bag, const unsigned depth,
+                            const unsigned splitDepth, const size_t first, std::vector<BagCounter>& counters) {
+    if (!splitDepth || depth == 1) {
+        pool.submit([&counters, s = state, bag, depth, first](const size_t id) {
+            counters[id].nodes += perft_bag_walk(s, bag, depth, counters[id].counts.data() + first);
+        });
+        return;
+    }
+
+    const size_t stride = bag.deal(bag.first()).queues(depth - 1);
+    size_t offset = first;
+    for (Piece p = I; p < PIECE_NB; p = static_cast<Piece>(p + 1)) {
+        if (!bag.allows(p))
+            continue;
+        for (const Move& move : MoveList(state.board, p)) {
+            State nextState = state;
+            nextState.do_move(move);
+            perft_bag_split(pool, nextState, bag.deal(p), depth - 1, splitDepth - 1, offset, counters);
+        }
+        offset += stride;
+    }
+}
+
+uint64_t perft_bag(const State& state, const unsigned offset, const PerftOptions& options,
+                   std::vector<uint64_t>& counts, std::vector<uint64_t>& threadNodes) {
+    assert(options.depth > 0);
+    const Bag bag = Bag::after(offset);
+    std::vector<BagCounter> counters(options.threads, BagCounter{0, std::vector<uint64_t>(bag.queues(options.depth))});
+    {
+        ThreadPool pool(options.threads);
+        perft_bag_split(pool, state, bag, options.depth, options.splitDepth, 0, counters);
+        pool.wait();
+    }
+
+    uint64_t nodes = 0;
+    counts.assign(bag.queues(options.depth), 0);
+    threadNodes.clear();
+    for (const auto& c : counters) {
+        threadNodes.push_back(c.nodes);
+        nodes += c.nodes;
+        for (size_t i = 0; i < counts.size(); ++i)
+            counts[i] += c.counts[i];
+    }
+    return nodes;
+}
+
+std::vector<std::string> bag_queues(const unsigned offset, const unsigned depth) {
+    std::vector<std::string> queues;
+    std::string queue;
+    auto walk = [&](auto&& self, const Bag bag, const unsigned d) -> void {
+        if (!d) {
+            queues.push_back(queue);
+            return;
+        }
+        for (Piece p = I; p < PIECE_NB; p = static_cast<Piece>(p + 1))
+            if (bag.allows(p)) {
+                queue.push_back("IOTLJSZ"[p]);
+                self(self, bag.deal(p), d - 1);
+                queue.pop_back();
+            }
+    };
+    walk(walk, Bag::after(offset), depth);
+    return queues;
+}
+
+static std::string move_string(const Move& m) {
+    std::string output;
+    output += "IOTLJSZ"[m.piece()];
+    output += "NESW"[m.rotation()];
+    output += ' ' + std::to_string(m.x()) + ' ' + std::to_string(m.y());
+    if (m.spin() != NO_SPIN)
+        output += m.spin() == FULL ? " spin" : " mini";
+    return output;
+}
+
+static bool parse_queue(const std::string& str, std::vector<Piece>& queue) {
+    queue.clear();
+    for (const char c : str) {
+        const char* const p = std::strchr("IOTLJSZ", std::toupper(static_cast<unsigned char>(c)));
+        if (!p || !c)
+            return false;
+        queue.push_back(static_cast<Piece>(p - "IOTLJSZ"));
+    }
+    return !queue.empty();
+}
+
+// Root state and queue of options, the empty board and I O L J S Z T unless overridden
+static bool perft_position(const PerftOptions& options, State& state, std::vector<Piece>& queue) {
     state.init();
+    if (!state.board.set(options.board)) {
+        std::cerr << "Invalid board: " << options.board << std::endl;
+        return false;
+    }
+    state.key = state.compute_key();
+
+    queue = options.queue.empty() ? std::vector<Piece>{I, O, L, J, S, Z, T} : options.queue;
+    return true;
+}
+
+void bench_perft(const PerftOptions& options) {
+    State state;
+    std::vector<Piece> queue;
+    if (!perft_position(options, state, queue))
+        return;
+
+    PerftOptions opts = options;
+    // Without hold every ply consumes one queue piece, hold walks stop at the end of the queue
+    if (!opts.hold && opts.depth > queue.size()) {
+        std::cerr << "Depth limited to the queue size " << queue.size() << std::endl;
+        opts.depth = static_cast<unsigned>(queue.size());
+    }
+
+    TranspositionTable tt;
+    if (opts.hashMb && !tt.resize(opts.hashMb)) {
+        std::cerr << "Could not allocate " << opts.hashMb << "MB of hash, running without a table" << std::endl;
+        opts.hashMb = 0;
+    }
+    TranspositionTable* const table = opts.hashMb ? &tt : nullptr;
+
+    std::vector<uint64_t> threadNodes;
+    PerftStats stats{};
+    const Piece* const first = queue.data();
+    const Piece* const last = queue.data() + queue.size();
 
     const auto start = std::chrono::high_resolution_clock::now();
 
-    const uint64_t nodes = perft(state, queue, depth);
+    auto count = [&](State root, const Piece* next, const unsigned depth) {
+        if (opts.threads <= 1)
+            return perft_run(root, next, last, depth, opts, table, stats);
+
+        PerftOptions o = opts;
+        o.depth = depth;
+        std::vector<uint64_t> n;
+        const uint64_t result = perft_parallel(root, next, last, o, table, n, stats);
+        threadNodes.resize(n.size());
+        for (size_t i = 0; i < n.size(); ++i)
+            threadNodes[i] += n[i];
+        return result;
+    };
+
+    uint64_t nodes = 0;
+    if (opts.divide && !opts.hold && opts.depth > 1)
+        for (const Move& move : MoveList(state.board, *first)) {
+            State child = state;
+            child.do_move(move);
+            const uint64_t n = count(child, first + 1, opts.depth - 1);
+            std::cout << move_string(move) << ": " << n << std::endl;
+            nodes += n;
+        }
+    else {
+        if (opts.divide)
+            std::cerr << "Divide needs depth > 1 and no hold" << std::endl;
+        nodes = count(state, first, opts.depth);
+    }
 
     const auto end = std::chrono::high_resolution_clock::now();
     const auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
-    std::cout << "Depth: " << depth
+    std::cout << "Depth: " << opts.depth
+              << " Mode: " << (opts.hold ? opts.mode == UNIQUE && !table ? "hold unique" : "hold" : PerftModeNames[opts.mode])
               << " Nodes: " << nodes
               << " Time: " << dt << "ms"
               << " NPS: " << (nodes * 1000) / static_cast<uint64_t>(dt + 1) << std::endl;
+
+    for (size_t i = 0; i < threadNodes.size(); ++i)
+        std::cout << "Thread " << i << ": " << threadNodes[i] << std::endl;
+
+    if (opts.hashMb)
+        std::cout << "TT: " << opts.hashMb << "MB"
+                  << " Probes: " << stats.probes
+                  << " Hits: " << stats.hits
+                  << " Hit rate: " << (stats.probes ? 100.0 * static_cast<double>(stats.hits) / static_cast<double>(stats.probes) : 0.0)
+                  << "%" << std::endl;
+
+    if (stats.lists)
+        std::cout << "Lists: " << stats.lists
+                  << " Pruned: " << stats.pruned
+                  << " Per list: " << static_cast<double>(stats.pruned) / static_cast<double>(stats.lists) << std::endl;
+}
+
+void bench_bag(const PerftOptions& options) {
+    State state;
+    std::vector<Piece> queue;
+    if (!perft_position(options, state, queue))
+        return;
+    if (!options.depth || options.offset >= PIECE_NB) {
+        std::cerr << "Bag perft needs depth > 0 and offset < " << PIECE_NB << std::endl;
+        return;
+    }
+
+    // While the first bag still holds depth pieces, any depth of the 7 can come
+    // in any order: offsets up to PIECE_NB - depth deal the same queues
+    const unsigned same = options.depth < PIECE_NB ? PIECE_NB - options.depth : 0;
+    std::vector<unsigned> offsets;
+    if (options.offset >= 0)
+        offsets.push_back(static_cast<unsigned>(options.offset));
+    else
+        for (unsigned offset = 0; offset < PIECE_NB; offset = offset ? offset + 1 : same + 1)
+            offsets.push_back(offset);
+
+    std::vector<uint64_t> threadNodes(options.threads);
+    std::map<std::string, uint64_t> distinct; // Queues dealt by several offsets are counted once
+    uint64_t searched = 0;
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    for (const unsigned offset : offsets) {
+        std::vector<uint64_t> counts, n;
+        const uint64_t nodes = perft_bag(state, offset, options, counts, n);
+        const std::vector<std::string> queues = bag_queues(offset, options.depth);
+        assert(queues.size() == counts.size());
+
+        searched += nodes;
+        for (size_t i = 0; i < n.size(); ++i)
+            threadNodes[i] += n[i];
+        for (size_t i = 0; i < counts.size(); ++i)
+            distinct[queues[i]] = counts[i];
+
+        const std::string name = options.offset < 0 && !offset && same ? "0-" + std::to_string(same) : std::to_string(offset);
+        if (options.divide)
+            for (size_t i = 0; i < counts.size(); ++i)
+                std::cout << name << " " << queues[i] << ": " << counts[i] << std::endl;
+
+        const auto [lo, hi] = std::minmax_element(counts.begin(), counts.end());
+        std::cout << "Offset: " << name
+                  << " Queues: " << counts.size()
+                  << " Nodes: " << nodes
+                  << " Mean: " << nodes / counts.size()
+                  << " Min: " << queues[static_cast<size_t>(lo - counts.begin())] << " " << *lo
+                  << " Max: " << queues[static_cast<size_t>(hi - counts.begin())] << " " << *hi << std::endl;
+    }
+
+    const auto end = std::chrono::high_resolution_clock::now();
+    const auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+    uint64_t nodes = 0;
+    for (const auto& [q, n] : distinct)
+        nodes += n;
+
+    std::cout << "Depth: " << options.depth
+              << " Queues: " << distinct.size()
+              << " Nodes: " << nodes
+              << " Searched: " << searched
+              << " Time: " << dt << "ms"
+              << " NPS: " << (searched * 1000) / static_cast<uint64_t>(dt + 1) << std::endl;
+
+    if (options.threads > 1)
+        for (size_t i = 0; i < threadNodes.size(); ++i)
+            std::cout << "Thread " << i << ": " << threadNodes[i] << std::endl;
+}
+
+void bench_pc(const PerftOptions& options) {
+    struct Position {
+        std::string name;
+        std::string board;
+        std::string queue;
+        int height;
+    };
+
+    // The 7 clears of a 7-bag PC loop from the empty board, each seeing the 11
+    // pieces from where the previous one ended, and a 6-row clear of a 4-wide well.
+    // They stand in for named openers, whose setups can be run with board and queue.
+    const std::string bags = "IOTLJSZ" "TZLOJIS" "OSJTZLI" "LIZSOTJ" "JTOIZSL" "SLIJTOZ" "ZJSITLO" "TOLZIJS" "OZTSLJI" "JISOLZT" "T";
+    std::vector<Position> positions;
+    for (size_t i = 0; i < 7; ++i)
+        positions.push_back({"pc" + std::to_string(i + 1), "", bags.substr(i * 10, 11), 4});
+    positions.push_back({"well6", "....######/....######/....######/....######/....######/....######", "JLOTISZ", 6});
+
+    const bool custom = !options.board.empty() || !options.queue.empty();
+    if (custom)
+        positions = {{"custom", options.board, "", options.height}};
+
+    PC::Limits limits;
+    limits.hold = custom ? options.hold : true;
+    limits.solutions = options.solutions;
+    limits.movetime = options.movetime;
+    limits.hashMb = options.hashMb ? options.hashMb : limits.hashMb;
+
+    uint64_t nodes = 0;
+    int64_t time = 0;
+    for (const Position& position : positions) {
+        PerftOptions o = options;
+        o.board = position.board;
+        if (!custom)
+            parse_queue(position.queue, o.queue);
+
+        State state;
+        std::vector<Piece> queue;
+        if (!perft_position(o, state, queue))
+            return;
+
+        limits.height = position.height;
+        const PC::Result r = PC::solve(state, queue.data(), queue.data() + queue.size(), limits);
+        nodes += r.nodes;
+        time += r.time;
+
+        std::cout << position.name
+                  << " Solutions: " << r.solutions.size() << (r.complete ? "" : "+")
+                  << " Nodes: " << r.nodes
+                  << " Memo hits: " << r.memoHits
+                  << " Time: " << r.time << "ms" << std::endl;
+
+        const size_t shown = options.divide ? r.solutions.size() : std::min<size_t>(r.solutions.size(), 1);
+        for (size_t i = 0; i < shown; ++i) {
+            std::cout << " ";
+            for (const Move& m : r.solutions[i])
+                std::cout << " [" << move_string(m) << "]";
+            std::cout << std::endl;
+        }
+    }
+
+    std::cout << "Nodes: " << nodes
+              << " Time: " << time << "ms"
+              << " NPS: " << (nodes * 1000) / static_cast<uint64_t>(time + 1) << std::endl;
+}
+
+void bench_search(const PerftOptions& options) {
+    State state;
+    std::vector<Piece> queue;
+    if (!perft_position(options, state, queue))
+        return;
+
+    Search::Limits limits;
+    limits.width = std::max(options.width, 1U);
+    limits.depth = options.depth;
+    limits.threads = options.threads;
+    limits.hold = options.hold;
+    limits.nodes = options.nodes;
+    limits.movetime = options.movetime;
+
+    const Search::Result r = Search::search(state, queue.data(), queue.data() + queue.size(), limits);
+
+    std::cout << "Depth: " << r.depth
+              << " Width: " << limits.width
+              << " Nodes: " << r.nodes
+              << " Time: " << r.time << "ms"
+              << " NPS: " << (r.nodes * 1000) / static_cast<uint64_t>(r.time + 1) << std::endl;
+
+    if (r.move == Move::none())
+        std::cout << "Best: none" << std::endl;
+    else
+        std::cout << "Best: " << move_string(r.move) << " Score: " << r.score << " Sent: " << r.sent << std::endl;
+}
+
+template<typename T>
+static void keep(const T& v) {
+    asm volatile("" : : "g"(&v) : "memory");
+}
+
+// A named set of boards the generator benches run over
+struct Workload {
+    const char* name;
+    std::vector<Board> boards;
+};
+
+// Best of passes of f(item, p) over every item and piece, in ns per call. The
+// gaps between the variants a bench compares are small next to the noise.
+template<typename T, typename F>
+static double best_of_passes(const std::vector<T>& items, F&& f, const int passes = 3) {
+    double best = 0;
+    for (int pass = 0; pass < passes; ++pass) {
+        uint64_t sum = 0;
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (const T& item : items)
+            for (const Piece p : allPieces)
+                sum += static_cast<uint64_t>(f(item, p));
+        const auto end = std::chrono::high_resolution_clock::now();
+        keep(sum);
+        const auto dt = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        const double ns = static_cast<double>(dt) / static_cast<double>(items.size() * PIECE_NB);
+        best = pass ? std::min(best, ns) : ns;
+    }
+    return best;
+}
+
+// Boards reached by the first plies of the default queue, as a generation workload
+static std::vector<Board> sample_boards(const unsigned plies) {
+    const Piece queue[] = {I, O, L, J, S, Z, T};
+    std::vector<Board> boards;
+    auto walk = [&](auto&& self, const State& state, const unsigned depth) -> void {
+        boards.push_back(state.board);
+        if (depth == plies)
+            return;
+        for (const Move& move : MoveList(state.board, queue[depth])) {
+            State nextState = state;
+            nextState.do_move(move);
+            self(self, nextState, depth + 1);
+        }
+    };
+
+    State state;
+    state.init();
+    walk(walk, state, 0);
+    return boards;
+}
+
+void bench_generate_all(const unsigned plies) {
+    const std::vector<Board> boards = sample_boards(plies);
+    Move separate[PIECE_NB * MAX_MOVES];
+    Move batched[PIECE_NB * MAX_MOVES];
+    MoveOutcome outcomes[PIECE_NB * MAX_MOVES];
+    Move* ranges[PIECE_NB + 1];
+
+    for (const Board& b : boards) {
+        Move* last = separate;
+        for (const Piece p : allPieces)
+            last = generate(b, last, p, false);
+        if (generate_all(b, batched, ALL_PIECES, false, ranges) - batched != last - separate
+            || !std::equal(separate, last, batched)) {
+            std::cerr << "generate_all mismatch" << b.to_string() << std::endl;
+            return;
+        }
+    }
+
+    // Best of 5 passes, in ns per board
+    auto time = [&](auto&& f) {
+        double best = 0;
+        for (int pass = 0; pass < 5; ++pass) {
+            uint64_t moves = 0;
+            const auto start = std::chrono::high_resolution_clock::now();
+            for (const Board& b : boards)
+                moves += f(b);
+            const auto end = std::chrono::high_resolution_clock::now();
+            keep(moves);
+            const auto dt = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            const double ns = static_cast<double>(dt) / static_cast<double>(boards.size());
+            best = pass ? std::min(best, ns) : ns;
+        }
+        return best;
+    };
+
+    const double dt1 = time([&](const Board& b) {
+        Move* last = separate;
+        for (const Piece p : allPieces)
+            last = generate(b, last, p, false);
+        return static_cast<uint64_t>(last - separate);
+    });
+    const double dt2 = time([&](const Board& b) {
+        return static_cast<uint64_t>(generate_all(b, batched, ALL_PIECES, false, ranges) - batched);
+    });
+    const double dt3 = time([&](const Board& b) {
+        Move* last = separate;
+        for (const Piece p : allPieces)
+            last = generate(b, last, p, false, outcomes + (last - separate));
+        return static_cast<uint64_t>(last - separate);
+    });
+    const double dt4 = time([&](const Board& b) {
+        return static_cast<uint64_t>(generate_all(b, batched, ALL_PIECES, false, ranges, outcomes) - batched);
+    });
+
+    uint64_t moves = 0;
+    for (const Board& b : boards)
+        moves += static_cast<uint64_t>(generate_all(b, batched, ALL_PIECES, false, ranges) - batched);
+
+    std::cout << "Boards: " << boards.size() << " Moves: " << moves << std::endl;
+    std::cout << "Separate: " << dt1 << "ns/board" << std::endl;
+    std::cout << "Batched:  " << dt2 << "ns/board" << std::endl;
+    std::cout << "Separate with outcomes: " << dt3 << "ns/board" << std::endl;
+    std::cout << "Batched with outcomes:  " << dt4 << "ns/board" << std::endl;
+}
+
+// Garbage-style boards of random height: every row has a random fill and at
+// least one hole, which gives the overhangs and tucks the surface boards lack
+static std::vector<Board> random_boards(const size_t count, const int minHeight, const int maxHeight, const uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<Board> boards(count);
+    for (Board& b : boards) {
+        b.clear();
+        const int height = minHeight + static_cast<int>(rng() % static_cast<uint64_t>(maxHeight - minHeight + 1));
+        for (int y = 0; y < height; ++y) {
+            unsigned row = static_cast<unsigned>(rng()) & static_cast<unsigned>(rng()) & ((1U << COL_NB) - 1);
+            row = ~row & ((1U << COL_NB) - 1); // About three quarters filled
+            if (row == (1U << COL_NB) - 1)
+                row &= ~(1U << (rng() % COL_NB));
+            for (int x = 0; x < COL_NB; ++x)
+                if (row & (1U << x))
+                    b[x] |= bb(y);
+        }
+    }
+    return boards;
+}
+
+// Total order on moves for comparing generators as sets
+static bool move_less(const Move& m, const Move& n) {
+    auto key = [](const Move& v) {
+        return static_cast<unsigned>(v.x()) << 16 | static_cast<unsigned>(v.y()) << 8
+             | static_cast<unsigned>(v.rotation()) << 6 | static_cast<unsigned>(v.piece()) << 2 | v.spin();
+    };
+    return key(m) < key(n);
+}
+
+void bench_flood(const size_t count) {
+    const Workload workloads[] = {
+        {"low", sample_boards(3)},
+        {"messy", random_boards(count, 4, 12, 1)},
+        {"high", random_boards(count, 14, 24, 2)},
+    };
+
+    Move a[MAX_MOVES], b[MAX_MOVES], c[MAX_MOVES];
+    for (const auto& [name, boards] : workloads) {
+        size_t missing = 0, extra = 0;
+        uint64_t moves = 0;
+        for (const Board& board : boards)
+            for (const Piece p : allPieces) {
+                Move* const lastA = generate(board, a, p, true, WORKLIST);
+                Move* const lastB = generate(board, b, p, true, FLOOD);
+                moves += static_cast<uint64_t>(lastA - a);
+                std::sort(a, lastA, move_less);
+                std::sort(b, lastB, move_less);
+                const size_t common = static_cast<size_t>(std::set_intersection(a, lastA, b, lastB, c, move_less) - c);
+                if (common != static_cast<size_t>(lastA - a) && !missing)
+                    std::cerr << "Flood misses moves for piece " << "IOTLJSZ"[p] << board.to_string() << std::endl;
+                missing += static_cast<size_t>(lastA - a) - common;
+                extra += static_cast<size_t>(lastB - b) - common;
+            }
+
+        auto time = [&](const Engine engine) {
+            return best_of_passes(boards, [&](const Board& board, const Piece p) {
+                return generate(board, a, p, true, engine) - a;
+            });
+        };
+
+        const double worklist = time(WORKLIST);
+        const double flood = time(FLOOD);
+
+        std::cout << "Boards: " << name << " (" << boards.size() << ")"
+                  << " Moves: " << moves
+                  << " Worklist: " << worklist << "ns"
+                  << " Flood: " << flood << "ns"
+                  << " Missing: " << missing
+                  << " Extra: " << extra << std::endl;
+    }
+}
+
+void bench_narrow(const size_t count) {
+    const Workload workloads[] = {
+        {"low", sample_boards(3)},
+        {"messy", random_boards(count, 4, 12, 1)},
+        {"high", random_boards(count, 14, 24, 2)},
+    };
+
+    std::cout << "Board: " << sizeof(Board) << " bytes NarrowBoard: " << sizeof(NarrowBoard) << " bytes"
+              << " State: " << sizeof(State) << " bytes NarrowState: " << sizeof(NarrowState) << " bytes" << std::endl;
+
+    Move moves[MAX_MOVES];
+    for (const auto& [name, boards] : workloads) {
+        std::vector<NarrowBoard> narrow(boards.size());
+        for (size_t i = 0; i < boards.size(); ++i)
+            narrow[i].set(boards[i]);
+
+        size_t mismatches = 0;
+        uint64_t total = 0;
+        for (size_t i = 0; i < boards.size(); ++i)
+            for (const Piece p : allPieces) {
+                const size_t n = count_moves(boards[i], p);
+                mismatches += n != count_moves(narrow[i], p);
+                total += n;
+            }
+
+        auto generate_list = [&](const auto& b, const Piece p) { return generate(b, moves, p, false) - moves; };
+        const double wide = best_of_passes(boards, generate_list);
+        const double narrowNs = best_of_passes(narrow, generate_list);
+
+        std::cout << "Boards: " << name << " (" << boards.size() << ")"
+                  << " Moves: " << total
+                  << " Board: " << wide << "ns"
+                  << " NarrowBoard: " << narrowNs << "ns"
+                  << " Mismatches: " << mismatches << std::endl;
+    }
+}
+
+// Boards of random play from the empty board, with line clears, stacked wells and T slots
+static std::vector<Board> random_play_boards(const size_t count, const unsigned maxPlies, const uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<Board> boards;
+    while (boards.size() < count) {
+        State state;
+        state.init();
+        const unsigned plies = 1 + static_cast<unsigned>(rng() % maxPlies);
+        for (unsigned i = 0; i < plies; ++i) {
+            const MoveList moves(state.board, static_cast<Piece>(rng() % PIECE_NB));
+            if (moves.empty())
+                break;
+            state.do_move(moves.begin()[rng() % moves.size()]);
+        }
+        boards.push_back(state.board);
+    }
+    return boards;
+}
+
+// Filtered generate() and count_moves() of the filter make(b) against the full
+// list of b filtered with keep(b, move)
+template<typename Make, typename Keep>
+static void bench_filter_query(const char* name, const std::vector<Board>& boards, Make&& make, Keep&& keep) {
+    Move full[MAX_MOVES];
+    Move moves[MAX_MOVES];
+
+    size_t mismatches = 0;
+    uint64_t kept = 0;
+    for (const Board& b : boards) {
+        const auto filter = make(b);
+        for (const Piece p : allPieces) {
+            Move* const last = std::remove_if(full, generate(b, full, p, false), [&](const Move& m) { return !keep(b, m); });
+            Move* const l = generate(b, moves, p, false, filter);
+            mismatches += !std::equal(full, last, moves, l) || count_moves(b, p, false, filter) != static_cast<size_t>(l - moves);
+            kept += static_cast<uint64_t>(l - moves);
+        }
+    }
+
+    // The filter is built once per board, with the first piece, and timed as well
+    auto time = [&](auto&& f) {
+        std::optional<decltype(make(boards[0]))> filter;
+        return best_of_passes(boards, [&](const Board& b, const Piece p) {
+            if (p == allPieces[0])
+                filter.emplace(make(b));
+            return f(b, p, *filter);
+        });
+    };
+
+    const double plain = time([&](const Board& b, const Piece p, const auto&) {
+        return generate(b, full, p, false) - full;
+    });
+    const double post = time([&](const Board& b, const Piece p, const auto&) {
+        return std::count_if(full, generate(b, full, p, false), [&](const Move& m) { return keep(b, m); });
+    });
+    const double masked = time([&](const Board& b, const Piece p, const auto& filter) {
+        return generate(b, moves, p, false, filter) - moves;
+    });
+    const double counted = time([&](const Board& b, const Piece p, const auto& filter) {
+        return count_moves(b, p, false, filter);
+    });
+
+    std::cout << "  " << name
+              << " Kept: " << kept
+              << " Unfiltered: " << plain << "ns"
+              << " Post-filter: " << post << "ns"
+              << " Masked: " << masked << "ns"
+              << " Count: " << counted << "ns"
+              << " Mismatches: " << mismatches << std::endl;
+}
+
+void bench_filter(const size_t count) {
+    const Workload workloads[] = {
+        {"played", random_play_boards(count, 40, 3)},
+        {"messy", random_boards(count, 4, 12, 1)},
+    };
+
+    for (const auto& [name, boards] : workloads) {
+        std::cout << "Boards: " << name << " (" << boards.size() << ")" << std::endl;
+
+        bench_filter_query("clears", boards, [](const Board& b) { return Filter::LineClears(b); },
+                           [](const Board& b, const Move& m) {
+                               Board c = b;
+                               c.place(m);
+                               return c.line_clears() != 0;
+                           });
+        bench_filter_query("spins", boards, [](const Board&) { return Filter::Spins(); },
+                           [](const Board&, const Move& m) { return m.spin() != NO_SPIN; });
+        bench_filter_query("below4", boards, [](const Board&) { return Filter::Below(4); },
+                           [](const Board&, const Move& m) {
+                               const PieceCoordinates pc = m.cells();
+                               return pc[0].y < 4 && pc[1].y < 4 && pc[2].y < 4 && pc[3].y < 4;
+                           });
+    }
+}
+
+// Bottom rows filled but for the cells of one placement spanning all of them, so
+// that placement (when reachable) is a perfect clear
+static std::vector<Board> pc_boards(const size_t count, const uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<Board> boards;
+    while (boards.size() < count) {
+        const Piece p = static_cast<Piece>(rng() % PIECE_NB);
+        const Rotation r = static_cast<Rotation>(rng() % ROTATION_NB);
+        const PieceCoordinates cells = piece_table(p, r);
+        int bottom = 0, top = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            bottom = std::min<int>(bottom, cells[i].y);
+            top = std::max<int>(top, cells[i].y);
+        }
+        const Move m(p, r, static_cast<int>(rng() % COL_NB), -bottom);
+        const PieceCoordinates pc = m.cells();
+        if (!is_ok_x(pc[0].x) || !is_ok_x(pc[1].x) || !is_ok_x(pc[2].x) || !is_ok_x(pc[3].x))
+            continue;
+
+        Board b;
+        b.clear();
+        for (int x = 0; x < COL_NB; ++x)
+            b[x] = bb_low(top - bottom + 1);
+        b.remove(m);
+        boards.push_back(b);
+    }
+    return boards;
+}
+
+void bench_outcomes(const size_t count) {
+    const Workload workloads[] = {
+        {"played", random_play_boards(count, 40, 3)},
+        {"messy", random_boards(count, 4, 12, 1)},
+        {"pc", pc_boards(count, 4)},
+    };
+
+    Move moves[MAX_MOVES];
+    MoveOutcome outcomes[MAX_MOVES];
+    for (const auto& [name, boards] : workloads) {
+        std::vector<State> states(boards.size());
+        for (size_t i = 0; i < boards.size(); ++i) {
+            states[i].init();
+            states[i].board = boards[i];
+            states[i].key = states[i].compute_key();
+        }
+
+        size_t mismatches = 0;
+        uint64_t total = 0, clears = 0, pcs = 0;
+        for (const State& state : states)
+            for (const Piece p : allPieces) {
+                Move* const last = generate(state.board, moves, p, false, outcomes);
+                for (const Move* m = moves; m != last; ++m) {
+                    const MoveOutcome& o = outcomes[m - moves];
+                    State child = state;
+                    const MoveInfo info = child.do_move(*m);
+                    mismatches += o.clear != info.clear || o.pc != info.pc || (info.clear && o.spin != info.spin);
+                    clears += o.clear > 0;
+                    pcs += o.pc;
+                }
+                total += static_cast<uint64_t>(last - moves);
+            }
+
+        // Both include the generation
+        const double played = best_of_passes(states, [&](const State& state, const Piece p) {
+            uint64_t sum = 0;
+            for (const Move* m = moves, *last = generate(state.board, moves, p, false); m != last; ++m) {
+                State child = state;
+                const MoveInfo info = child.do_move(*m);
+                sum += static_cast<uint64_t>(info.clear + info.pc);
+            }
+            return sum;
+        });
+        const double bulk = best_of_passes(states, [&](const State& state, const Piece p) {
+            uint64_t sum = 0;
+            const Move* const last = generate(state.board, moves, p, false, outcomes);
+            for (const MoveOutcome* o = outcomes; o != outcomes + (last - moves); ++o)
+                sum += static_cast<uint64_t>(o->clear + o->pc);
+            return sum;
+        });
+
+        std::cout << "Boards: " << name << " (" << boards.size() << ")"
+                  << " Moves: " << total
+                  << " Clears: " << clears
+                  << " PCs: " << pcs
+                  << " do_move: " << played << "ns"
+                  << " Outcomes: " << bulk << "ns"
+                  << " Mismatches: " << mismatches << std::endl;
+    }
+}
+
+void bench_stream(const size_t count) {
+    const Workload workloads[] = {
+        {"played", random_play_boards(count, 40, 3)},
+        {"messy", random_boards(count, 4, 12, 1)},
+    };
+
+    Move eager[MAX_MOVES];
+    Move moves[MAX_MOVES];
+    MoveStream stream;
+    for (const auto& [name, boards] : workloads) {
+        size_t mismatches = 0;
+        uint64_t total = 0, batches = 0, firstMoves = 0;
+        for (const Board& b : boards)
+            for (const Piece p : allPieces) {
+                Move* const last = generate(b, eager, p, false, WORKLIST);
+                const Move* e = eager;
+                stream.reset(b, p);
+                for (Move* end; (end = stream.next(moves)) != moves; ++batches) {
+                    if (e == eager)
+                        firstMoves += static_cast<uint64_t>(end - moves);
+                    for (const Move* m = moves; m != end; ++m)
+                        mismatches += e == last || !(*m == *e++);
+                }
+                mismatches += e != last;
+                total += static_cast<uint64_t>(last - eager);
+            }
+
+        const double full = best_of_passes(boards, [&](const Board& b, const Piece p) {
+            return static_cast<uint64_t>(generate(b, eager, p, false, WORKLIST) - eager);
+        });
+        const double first = best_of_passes(boards, [&](const Board& b, const Piece p) {
+            stream.reset(b, p);
+            return static_cast<uint64_t>(stream.next(moves) - moves);
+        });
+        const double drained = best_of_passes(boards, [&](const Board& b, const Piece p) {
+            uint64_t n = 0;
+            stream.reset(b, p);
+            for (Move* end; (end = stream.next(moves)) != moves;)
+                n += static_cast<uint64_t>(end - moves);
+            return n;
+        });
+
+        std::cout << "Boards: " << name << " (" << boards.size() << ")"
+                  << " Moves: " << total
+                  << " Batches: " << batches
+                  << " First batch: " << static_cast<double>(firstMoves) / static_cast<double>(boards.size() * PIECE_NB) << " moves"
+                  << " Eager: " << full << "ns"
+                  << " To first batch: " << first << "ns"
+                  << " Drained: " << drained << "ns"
+                  << " Overhead: " << 100.0 * (drained - full) / full << "%"
+                  << " Mismatches: " << mismatches << std::endl;
+    }
+}
+
+bool bench_fuzz(const PerftOptions& options) {
+    const Workload workloads[] = {
+        {"garbage", random_boards(options.count, 0, 12, options.seed)},
+        {"high", random_boards(options.count / 4, 16, 26, options.seed + 1)},
+        {"play", random_play_boards(options.count, 30, options.seed + 2)},
+    };
+
+    struct Generator {
+        const char* name;
+        Move* (*generate)(const Board&, Move*, Piece, bool);
+    };
+    const Generator generators[] = {
+        {"default", [](const Board& b, Move* moves, Piece p, bool force) { return generate(b, moves, p, force); }},
+        {"worklist", [](const Board& b, Move* moves, Piece p, bool force) { return generate(b, moves, p, force, WORKLIST); }},
+        {"flood", [](const Board& b, Move* moves, Piece p, bool force) { return generate(b, moves, p, force, FLOOD); }},
+        {"narrow", [](const Board& b, Move* moves, Piece p, bool force) {
+            NarrowBoard narrow;
+            return narrow.set(b) ? generate(narrow, moves, p, force) : generate(b, moves, p, force);
+        }},
+        {"stream", [](const Board& b, Move* moves, Piece p, bool force) {
+            static MoveStream stream;
+            stream.reset(b, p, force);
+            for (Move* end; (end = stream.next(moves)) != moves;)
+                moves = end;
+            return moves;
+        }},
+    };
+
+    Move expected[MAX_MOVES], actual[MAX_MOVES], diff[MAX_MOVES];
+    size_t failures = 0;
+    uint64_t compared = 0;
+
+    auto report = [&](const char* title, const Move* first, const Move* last) {
+        std::cerr << "  " << title << ":";
+        for (const Move* m = first; m != last; ++m)
+            std::cerr << " [" << move_string(*m) << "]";
+        std::cerr << std::endl;
+    };
+
+    for (const auto& [name, boards] : workloads) {
+        size_t boardFailures = 0;
+        for (const Board& board : boards)
+            for (const Piece p : allPieces)
+                for (const bool force : {false, true}) {
+                    Move* const lastExpected = generate_reference(board, expected, p, force);
+                    std::sort(expected, lastExpected, move_less);
+
+                    for (const auto& [generatorName, generator] : generators) {
+                        Move* const lastActual = generator(board, actual, p, force);
+                        std::sort(actual, lastActual, move_less);
+                        compared += static_cast<uint64_t>(lastActual - actual);
+
+                        if (lastActual - actual == lastExpected - expected && std::equal(expected, lastExpected, actual))
+                            continue;
+
+                        if (failures++ < 5) {
+                            std::cerr << "Mismatch: " << generatorName << " piece " << "IOTLJSZ"[p]
+                                      << " force " << force << " board " << board.rows() << std::endl;
+                            report("missing", diff, std::set_difference(expected, lastExpected, actual, lastActual, diff, move_less));
+                            report("extra", diff, std::set_difference(actual, lastActual, expected, lastExpected, diff, move_less));
+                        }
+                        ++boardFailures;
+                    }
+                }
+
+        std::cout << "Boards: " << name << " (" << boards.size() << ") Failures: " << boardFailures << std::endl;
+    }
+
+    std::cout << "Moves compared: " << compared << " Failures: " << failures << std::endl;
+    return !failures;
+}
+
+bool bench_pack(const PerftOptions& options) {
+    if (options.output.empty()) {
+        std::cerr << "pack needs an output file" << std::endl;
+        return false;
+    }
+
+    std::vector<Board> boards = sample_boards(options.depth);
+    const std::vector<Board> messy = random_boards(boards.size(), 4, 24, 3);
+    boards.insert(boards.end(), messy.begin(), messy.end());
+
+    // Each record gets a shuffled bag as its queue
+    std::mt19937_64 rng(4);
+    std::vector<PackedState> records;
+    for (const Board& b : boards) {
+        Piece queue[] = {I, O, T, L, J, S, Z};
+        std::shuffle(std::begin(queue), std::end(queue), rng);
+        State state;
+        state.init();
+        state.board = b;
+        state.key = state.compute_key();
+        PackedState record;
+        if (record.pack(state, queue, PIECE_NB))
+            records.push_back(record);
+    }
+
+    if (!write_packed(options.output, records)) {
+        std::cerr << "Could not write " << options.output << std::endl;
+        return false;
+    }
+    std::cout << "Packed " << records.size() << " positions into " << options.output << std::endl;
+    return true;
+}
+
+bool bench_batch(const PerftOptions& options) {
+    PackedFile file;
+    if (!file.open(options.input)) {
+        std::cerr << "Could not map " << options.input << std::endl;
+        return false;
+    }
+
+    std::ofstream out;
+    if (!options.output.empty()) {
+        out.open(options.output, std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Could not open " << options.output << std::endl;
+            return false;
+        }
+    }
+    const bool write = out.is_open();
+
+    constexpr size_t CHUNK = 4096;
+    const size_t chunks = (file.size() + CHUNK - 1) / CHUNK;
+    // Chunks go out in waves so their buffers can be written in record order
+    const size_t wave = 4 * options.threads;
+    std::vector<std::string> buffers(wave);
+    std::vector<uint64_t> moveCounts(wave);
+    std::vector<uint64_t> invalidCounts(wave);
+    uint64_t moves = 0, invalid = 0;
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    {
+        ThreadPool pool(options.threads);
+        for (size_t first = 0; first < chunks; first += wave) {
+            const size_t n = std::min(wave, chunks - first);
+            for (size_t i = 0; i < n; ++i)
+                pool.submit([&, i, c = first + i](size_t) {
+                    std::string& buffer = buffers[i];
+                    buffer.clear();
+                    uint64_t count = 0, bad = 0;
+                    Move list[2 * MAX_MOVES];
+                    const PackedState* const last = std::min(file.begin() + (c + 1) * CHUNK, file.end());
+                    for (const PackedState* r = file.begin() + c * CHUNK; r != last; ++r) {
+                        // Skipped, with a line of its own to keep the output in record order
+                        if (!r->valid()) {
+                            ++bad;
+                            if (write)
+                                buffer += "invalid\n";
+                            continue;
+                        }
+
+                        Move* end = list;
+                        if (r->queueSize) {
+                            State state;
+                            r->unpack(state);
+                            const Piece p = r->piece(0);
+                            const Piece alt = state.hold != NO_PIECE ? state.hold : r->queueSize > 1 ? r->piece(1) : NO_PIECE;
+                            end = generate(state.board, end, p, false);
+                            if (end != list && alt != NO_PIECE && alt != p)
+                                end = generate(state.board, end, alt, false);
+                        }
+                        count += static_cast<uint64_t>(end - list);
+
+                        if (!write)
+                            continue;
+                        if (options.lists)
+                            for (const Move* m = list; m != end; ++m) {
+                                buffer += move_string(*m);
+                                buffer += m + 1 != end ? ',' : '\n';
+                            }
+                        if (!options.lists || end == list) {
+                            buffer += std::to_string(end - list);
+                            buffer += '\n';
+                        }
+                    }
+                    moveCounts[i] = count;
+                    invalidCounts[i] = bad;
+                });
+            pool.wait();
+
+            for (size_t i = 0; i < n; ++i) {
+                moves += moveCounts[i];
+                invalid += invalidCounts[i];
+                if (write)
+                    out << buffers[i];
+            }
+        }
+    }
+    const auto end = std::chrono::high_resolution_clock::now();
+    const auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+    std::cout << "Positions: " << file.size()
+              << " Invalid: " << invalid
+              << " Moves: " << moves
+              << " Time: " << dt << "ms"
+              << " Positions/s: " << (file.size() * 1000) / static_cast<uint64_t>(dt + 1) << std::endl;
+    return true;
+}
+
+void bench_move_cache(const PerftOptions& options) {
+    const Piece queue[] = {I, O, L, J, S, Z, T};
+    MoveCache cache;
+    if (!options.cacheFile.empty() && cache.load(options.cacheFile))
+        std::cout << "Mapped " << options.cacheFile << ": " << cache.size() << " entries" << std::endl;
+
+    auto run = [&](const char* name, auto&& f) {
+        State state;
+        state.init();
+        const auto start = std::chrono::high_resolution_clock::now();
+        const uint64_t nodes = f(state);
+        const auto end = std::chrono::high_resolution_clock::now();
+        const auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        std::cout << name << ": Nodes: " << nodes << " Time: " << dt << "ms"
+                  << " Hits: " << cache.hit_count() << " Misses: " << cache.miss_count() << std::endl;
+    };
+
+    run("Plain", [&](State& state) { return perft(state, queue, options.depth); });
+    run("Cold ", [&](State& state) { return perft_cached(state, queue, options.depth, cache); });
+    run("Warm ", [&](State& state) { return perft_cached(state, queue, options.depth, cache); });
+    std::cout << "Entries: " << cache.size() << std::endl;
+
+    if (!options.cacheFile.empty() && !cache.save(options.cacheFile))
+        std::cerr << "Could not write " << options.cacheFile << std::endl;
+}
+
+template<Piece p>
+static void bench_collision_map(const std::vector<Board>& boards, const unsigned repeats) {
+    auto time = [&](auto&& build) {
+        Bitboard checksum = 0;
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned i = 0; i < repeats; ++i)
+            for (const Board& b : boards) {
+                const Gen::CollisionMap<p> cm = build(b);
+                for (int x = 0; x < COL_NB; ++x)
+                    for (int r = 0; r < Gen::canonical_size<p>(); ++r)
+                        checksum += cm(x, static_cast<Rotation>(r));
+            }
+        const auto end = std::chrono::high_resolution_clock::now();
+        const auto dt = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        return std::pair{static_cast<double>(dt) / static_cast<double>(boards.size() * repeats), checksum};
+    };
+
+    const auto [scalar, c1] = time([](const Board& b) { return Gen::CollisionMap<p>::scalar(b); });
+    const auto [vector, c2] = time([](const Board& b) { return Gen::CollisionMap<p>(b); });
+
+    std::cout << "Piece " << "IOTLJSZ"[p]
+              << " Scalar: " << scalar << "ns"
+              << " Vector: " << vector << "ns"
+              << (c1 == c2 ? "" : " MISMATCH") << std::endl;
+}
+
+void bench_collision_maps(const unsigned plies) {
+    const std::vector<Board> boards = sample_boards(plies);
+    for (const Board& b : boards)
+        if (!(Gen::CollisionMap<T>(b) == Gen::CollisionMap<T>::scalar(b))) {
+            std::cerr << "CollisionMap mismatch" << b.to_string() << std::endl;
+            return;
+        }
+
+    std::cout << "Boards: " << boards.size() << " Lanes: " << Gen::LANE_NB << std::endl;
+    const unsigned repeats = 20;
+    bench_collision_map<I>(boards, repeats);
+    bench_collision_map<O>(boards, repeats);
+    bench_collision_map<T>(boards, repeats);
+    bench_collision_map<L>(boards, repeats);
+    bench_collision_map<J>(boards, repeats);
+    bench_collision_map<S>(boards, repeats);
+    bench_collision_map<Z>(boards, repeats);
+}
+
+struct CorpusPosition {
+    const char* name;
+    const char* board;
+    const char* queue;
+};
+
+// Flat, T-spin setups, perfect clear residue, cheese, and garbage both low and
+// high enough to take the slow spawn path
+constexpr CorpusPosition Corpus[] = {
+    {"empty", "", "IOLJSZT"},
+    {"tsd", "####....../###...####/####.#####", "TIOLJSZ"},
+    {"tst", "#....#####/###.######/###..#####/###.######", "TLJSZIO"},
+    {"pc", "......####/......####/.....#####/##...#####", "ILJTSZO"},
+    {"cheese", "#########./.#########/###.######/#####.####/##.#######/#######.##/#.########/######.###", "TIJLOSZ"},
+    {"messy", "#..#.###.#/..########/######.###/##.##..##./#.##.#.#.#/#...#..###/#.#.#..#../.##....###/####..##.#/####.##.##", "TSZLJIO"},
+    {"high", "#######.../###..#..##/###.##.#.#/#.########/########.#/##.####.##/###...#.##/###.#####./##.###.#.#/.####.##.#/"
+             ".######.##/#.###..###/########.#/########.#/#..#######/#.####..##/.##..#.###/####.#####/.########.", "TIOLJSZ"},
+};
+
+// Nanoseconds per call over the repeated samples
+struct Timing {
+    double min;
+    double median;
+    double stddev;
+};
+
+static Timing summarize(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    const double n = static_cast<double>(samples.size());
+    double mean = 0, var = 0;
+    for (const double v : samples)
+        mean += v / n;
+    for (const double v : samples)
+        var += (v - mean) * (v - mean) / n;
+    const size_t mid = samples.size() / 2;
+    const double median = samples.size() % 2 ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2;
+    return Timing{samples.front(), median, std::sqrt(var)};
+}
+
+template<typename F>
+static Timing measure(const unsigned repeat, const size_t calls, F&& f) {
+    std::vector<double> samples;
+    for (unsigned r = 0; r < std::max(repeat, 1U); ++r) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < calls; ++i)
+            f();
+        const auto end = std::chrono::high_resolution_clock::now();
+        const auto dt = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        samples.push_back(static_cast<double>(dt) / static_cast<double>(calls));
+    }
+    return summarize(std::move(samples));
+}
+
+struct PositionResult {
+    std::string name;
+    std::string board;
+    std::string queue;
+    size_t moves[PIECE_NB];
+    Stats::Counts counts[PIECE_NB]; // Of one generate() call, with stats=yes
+    Timing generate[PIECE_NB];
+    Timing collisionMap[PIECE_NB];
+    Timing spinMap;
+    size_t clears;
+    Timing clearLines;
+    size_t infos;
+    Timing linesSent;
+    uint64_t nodes;
+    double perftMs;
+};
+
+static PositionResult run_position(const PerftOptions& options, const std::string& name, const State& root, const std::vector<Piece>& queue) {
+    constexpr size_t calls = 2000;
+    const Board& b = root.board;
+
+    PositionResult result{};
+    result.name = name;
+    result.board = b.rows();
+    for (const Piece p : queue)
+        result.queue += "IOTLJSZ"[p];
+
+    Move moves[MAX_MOVES];
+    [&]<size_t... ps>(std::index_sequence<ps...>) {
+        auto piece = [&]<Piece p>{
+            const Stats::Counts before = Stats::total();
+            result.moves[p] = static_cast<size_t>(generate(b, moves, p, false) - moves);
+            result.counts[p] = Stats::total();
+            for (int s = 0; s < STAT_NB; ++s)
+                result.counts[p][s] -= before[s];
+            result.generate[p] = measure(options.repeat, calls, [&]{ keep(*generate(b, moves, p, false)); });
+            result.collisionMap[p] = measure(options.repeat, calls, [&]{ keep(Gen::CollisionMap<p>(b)); });
+        };
+        (piece.template operator()<static_cast<Piece>(ps)>(), ...);
+    }(std::make_index_sequence<PIECE_NB>());
+
+    result.spinMap = measure(options.repeat, calls, [&]{ keep(Gen::SpinMap(b)); });
+
+    // Children of every piece, as the inputs of the post-placement kernels
+    std::vector<Board> full;
+    std::vector<MoveInfo> infos;
+    for (const Piece p : allPieces)
+        for (const Move& move : MoveList(b, p)) {
+            Board child = b;
+            child.place(move);
+            if (child.line_clears())
+                full.push_back(child);
+            State s = root;
+            infos.push_back(s.do_move(move));
+        }
+
+    // Both kernels are timed over all children at once and reported per child
+    auto per_child = [](const Timing& t, const size_t n) {
+        const double d = static_cast<double>(std::max<size_t>(n, 1));
+        return Timing{t.min / d, t.median / d, t.stddev / d};
+    };
+
+    result.clears = full.size();
+    if (!full.empty())
+        result.clearLines = per_child(measure(options.repeat, calls / 10, [&]{
+            for (const Board& board : full) {
+                Board child = board;
+                child.clear_lines(child.line_clears());
+                keep(child);
+            }
+        }), full.size());
+
+    result.infos = infos.size();
+    result.linesSent = per_child(measure(options.repeat, calls / 10, [&]{
+        int sent = 0;
+        for (const MoveInfo& info : infos)
+            sent += info.lines_sent();
+        keep(sent);
+    }), infos.size());
+
+    PerftOptions opts = options;
+    opts.depth = std::min(options.depth, static_cast<unsigned>(queue.size()));
+    std::vector<uint64_t> threadNodes;
+    PerftStats stats{};
+    State state = root;
+    const auto start = std::chrono::high_resolution_clock::now();
+    result.nodes = opts.threads > 1
+        ? perft_parallel(state, queue.data(), queue.data() + queue.size(), opts, nullptr, threadNodes, stats)
+        : perft_run(state, queue.data(), queue.data() + queue.size(), opts.depth, opts, nullptr, stats);
+    const auto end = std::chrono::high_resolution_clock::now();
+    result.perftMs = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()) / 1000;
+
+    return result;
+}
+
+static void print_timing(std::ostream& os, const char* name, const Timing& t, const bool json) {
+    if (json)
+        os << "\"" << name << "\": {\"min\": " << t.min << ", \"median\": " << t.median << ", \"stddev\": " << t.stddev << "}";
+    else
+        os << name << " min " << t.min << "ns median " << t.median << "ns stddev " << t.stddev << "ns";
+}
+
+void bench_suite(const PerftOptions& options) {
+    std::vector<PositionResult> results;
+
+    if (!options.board.empty() || !options.queue.empty()) {
+        State state;
+        std::vector<Piece> queue;
+        if (!perft_position(options, state, queue))
+            return;
+        results.push_back(run_position(options, "custom", state, queue));
+    } else
+        for (const auto& [name, board, queueStr] : Corpus) {
+            State state;
+            state.init();
+            state.board.set(board);
+            state.key = state.compute_key();
+            std::vector<Piece> queue;
+            parse_queue(queueStr, queue);
+            results.push_back(run_position(options, name, state, queue));
+        }
+
+    const unsigned depth = options.depth;
+    std::ostream& os = std::cout;
+    if (!options.json) {
+        for (const auto& r : results) {
+            os << "Position: " << r.name << " Board: " << (r.board.empty() ? "-" : r.board) << " Queue: " << r.queue << std::endl;
+            for (const Piece p : allPieces) {
+                os << "  " << "IOTLJSZ"[p] << " moves " << r.moves[p] << " | ";
+                print_timing(os, "generate", r.generate[p], false);
+                os << " | ";
+                print_timing(os, "cmap", r.collisionMap[p], false);
+                os << std::endl;
+                if constexpr (STATS) {
+                    os << "    ";
+                    Stats::print(os, r.counts[p]);
+                }
+            }
+            os << "  ";
+            print_timing(os, "spinmap", r.spinMap, false);
+            os << std::endl << "  ";
+            print_timing(os, "clear_lines", r.clearLines, false);
+            os << " over " << r.clears << " boards" << std::endl << "  ";
+            print_timing(os, "lines_sent", r.linesSent, false);
+            os << " over " << r.infos << " moves" << std::endl;
+            os << "  perft depth " << std::min<size_t>(depth, r.queue.size()) << " nodes " << r.nodes << " time " << r.perftMs << "ms" << std::endl;
+        }
+        return;
+    }
+
+    os << "{\"repeat\": " << options.repeat << ", \"threads\": " << options.threads << ", \"positions\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        os << (i ? ", " : "") << "{\"name\": \"" << r.name << "\", \"board\": \"" << r.board << "\", \"queue\": \"" << r.queue << "\", \"pieces\": {";
+        for (const Piece p : allPieces) {
+            os << (p ? ", " : "") << "\"" << "IOTLJSZ"[p] << "\": {\"moves\": " << r.moves[p] << ", ";
+            print_timing(os, "generate", r.generate[p], true);
+            os << ", ";
+            print_timing(os, "cmap", r.collisionMap[p], true);
+            os << "}";
+        }
+        os << "}, \"kernels\": {";
+        print_timing(os, "spinmap", r.spinMap, true);
+        os << ", ";
+        print_timing(os, "clear_lines", r.clearLines, true);
+        os << ", ";
+        print_timing(os, "lines_sent", r.linesSent, true);
+        os << "}, \"perft\": {\"depth\": " << std::min<size_t>(depth, r.queue.size())
+           << ", \"nodes\": " << r.nodes << ", \"ms\": " << r.perftMs << "}}";
+    }
+    os << "]}" << std::endl;
+}
+
+bool bench(std::istream& is) {
+    std::string token;
+    std::string command = "perft";
+    if (is >> token)
+        command = token;
+
+    PerftOptions options;
+    if (command == "suite")
+        options.depth = 3;
+    else if (command == "bag")
+        options.depth = 3;
+
+    while (is >> token) {
+        if (token == "depth")
+            is >> options.depth;
+        else if (token == "threads")
+            is >> options.threads;
+        else if (token == "split")
+            is >> options.splitDepth;
+        else if (token == "hash")
+            is >> options.hashMb;
+        else if (token == "hold")
+            is >> options.hold;
+        else if (token == "cachefile")
+            is >> options.cacheFile;
+        else if (token == "board") {
+            is >> options.board;
+            Board b;
+            if (!b.set(options.board)) {
+                std::cerr << "Invalid board: " << options.board << std::endl;
+                return false;
+            }
+        }
+        else if (token == "queue") {
+            is >> token;
+            if (!parse_queue(token, options.queue)) {
+                std::cerr << "Invalid queue: " << token << std::endl;
+                return false;
+            }
+        }
+        else if (token == "divide")
+            is >> options.divide;
+        else if (token == "repeat")
+            is >> options.repeat;
+        else if (token == "json")
+            is >> options.json;
+        else if (token == "in")
+            is >> options.input;
+        else if (token == "out")
+            is >> options.output;
+        else if (token == "lists")
+            is >> options.lists;
+        else if (token == "count")
+            is >> options.count;
+        else if (token == "seed")
+            is >> options.seed;
+        else if (token == "width")
+            is >> options.width;
+        else if (token == "nodes")
+            is >> options.nodes;
+        else if (token == "movetime")
+            is >> options.movetime;
+        else if (token == "offset")
+            is >> options.offset;
+        else if (token == "height")
+            is >> options.height;
+        else if (token == "solutions")
+            is >> options.solutions;
+        else if (token == "mode") {
+            is >> token;
+            const auto it = std::find(std::begin(PerftModeNames), std::end(PerftModeNames), token);
+            if (it == std::end(PerftModeNames))
+                std::cerr << "Unknown perft mode: " << token << std::endl;
+            else
+                options.mode = static_cast<PerftMode>(it - std::begin(PerftModeNames));
+        }
+        else
+            std::cerr << "Unknown option: " << token << std::endl;
+    }
+
+    if (!options.threads)
+        options.threads = ThreadPool::default_threads();
+
+#ifdef USE_DISPATCH
+    // Roughly the clone the loader picked, on stderr to keep JSON output clean
+    std::cerr << "Kernels: " << (__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl") ? "x86-64-v4"
+                               : __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2") ? "x86-64-v3" : "x86-64")
+              << std::endl;
+#endif
+
+    // Cache mode maps the file once, every thread's MoveCache reads it from there
+    MoveCache mapped;
+    if ((command == "perft" || command == "suite") && options.mode == CACHED && !options.cacheFile.empty()) {
+        if (!mapped.load(options.cacheFile)) {
+            std::cerr << "Could not map " << options.cacheFile << std::endl;
+            return false;
+        }
+        options.cache = &mapped;
+    }
+
+    Stats::reset();
+    if (command == "perft")
+        bench_perft(options);
+    else if (command == "genall")
+        bench_generate_all(options.depth);
+    else if (command == "cmap")
+        bench_collision_maps(options.depth);
+    else if (command == "flood")
+        bench_flood(10000);
+    else if (command == "narrow")
+        bench_narrow(10000);
+    else if (command == "cache")
+        bench_move_cache(options);
+    else if (command == "suite")
+        bench_suite(options);
+    else if (command == "pack") {
+        if (!bench_pack(options))
+            return false;
+    }
+    else if (command == "batch") {
+        if (!bench_batch(options))
+            return false;
+    }
+    else if (command == "fuzz")
+        return bench_fuzz(options);
+    else if (command == "search")
+        bench_search(options);
+    else if (command == "bag")
+        bench_bag(options);
+    else if (command == "pc")
+        bench_pc(options);
+    else if (command == "filter")
+        bench_filter(options.count);
+    else if (command == "outcome")
+        bench_outcomes(options.count);
+    else if (command == "stream")
+        bench_stream(options.count);
+    else {
+        std::cerr << "Unknown command: " << command << std::endl;
+        return false;
+    }
+
+    if constexpr (STATS) {
+        std::cout << "Stats: ";
+        Stats::print(std::cout, Stats::total());
+    }
+    return true;
 }
 
 } // namespace Cobra
\ No newline at end of file
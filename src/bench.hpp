@@ -1,9 +1,169 @@
 #ifndef BENCH_H
 #define BENCH_H
 
+#include "board.hpp"
+#include "header.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
 namespace Cobra {
 
-void bench_perft();
+class MoveCache;
+class MoveStack;
+class TranspositionTable;
+
+enum PerftMode {
+    COPY_MAKE, MAKE_UNMAKE, ARENA, CACHED, UNIQUE, NARROW, PERFT_MODE_NB
+};
+
+constexpr std::string_view PerftModeNames[PERFT_MODE_NB] = {
+    "copy", "undo", "arena", "cache", "unique", "narrow"
+};
+
+struct PerftOptions {
+    unsigned depth = 7;
+    size_t threads = 1;
+    unsigned splitDepth = 2;
+    size_t hashMb = 0;
+    PerftMode mode = COPY_MAKE;
+    bool hold = false;
+    std::string cacheFile; // Mapped once by perft and suite in cache mode
+    const MoveCache* cache = nullptr; // The mapping, shared by every thread's MoveCache
+    std::string board;     // Board::set() rows, empty board by default
+    std::vector<Piece> queue;
+    bool divide = false;   // Node count per root move
+    unsigned repeat = 5;   // Samples per suite timing
+    bool json = false;
+    std::string input;     // PackedState files read and written by batch and pack
+    std::string output;
+    bool lists = false;    // Batch writes move lists rather than counts
+    size_t count = 10000;  // Fuzz boards per workload
+    uint64_t seed = 1;
+    unsigned width = 256;  // Beam width of search
+    uint64_t nodes = 0;    // Search budgets, 0 for none
+    int64_t movetime = 0;
+    int offset = -1;       // Pieces of the first bag already dealt in bag perft, every offset if negative
+    int height = 4;        // Rows of a perfect clear
+    size_t solutions = 1;  // Perfect clears to look for, 0 for all
+};
+
+struct PerftStats {
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t lists;  // Unique move lists built
+    uint64_t pruned; // Children they dropped
+};
+
+uint64_t perft(State& state, const Piece* next, unsigned depth);
+
+// Same walk as perft() but reverts each child with undo_move instead of copying the State
+uint64_t perft_undo(State& state, const Piece* next, unsigned depth);
+
+// Make/unmake walk whose move lists live in a shared per-thread MoveStack
+uint64_t perft_arena(State& state, const Piece* next, unsigned depth, MoveStack& stack);
+
+// Copy-make walk whose move lists of overhang-free boards come from a MoveCache
+uint64_t perft_cached(State& state, const Piece* next, unsigned depth, MoveCache& cache);
+
+// Copy-make walk expanding one child per distinct resulting State, see unique_moves()
+uint64_t perft_unique(State& state, const Piece* next, unsigned depth, PerftStats& stats);
+
+// perft_unique with hold over the queue [next, last), holding as perft_hold does
+uint64_t perft_unique_hold(State& state, const Piece* next, const Piece* last, unsigned depth, PerftStats& stats);
+
+// Copy-make walk on half-size states. A move reaching row 32 widens its child
+// to a State and continues as perft().
+uint64_t perft_narrow(NarrowState& state, const Piece* next, unsigned depth);
+
+// Memoizes subtree counts keyed on the state and the remaining queue
+uint64_t perft_tt(State& state, const Piece* next, unsigned depth, TranspositionTable& tt, PerftStats& stats);
+
+// Hold-aware perft over the queue [next, last). Holding into an empty slot
+// consumes the following queue piece as well. tt may be null.
+uint64_t perft_hold(State& state, const Piece* next, const Piece* last, unsigned depth,
+                    TranspositionTable* tt, PerftStats& stats);
+
+// Splits the tree options.splitDepth plies below the root and runs the subtrees on a
+// work-stealing pool. threadNodes receives the nodes counted by each thread.
+uint64_t perft_parallel(const State& state, const Piece* next, const Piece* last, const PerftOptions& options,
+                        TranspositionTable* tt, std::vector<uint64_t>& threadNodes, PerftStats& stats);
+
+// Perft over every queue of options.depth pieces a 7-bag randomizer deals once
+// offset pieces of the first bag are gone. A queue prefix shared by several
+// queues is searched once, the subtrees below options.splitDepth plies run on a
+// thread pool. counts receives the nodes of each queue in bag_queues() order.
+uint64_t perft_bag(const State& state, unsigned offset, const PerftOptions& options,
+                   std::vector<uint64_t>& counts, std::vector<uint64_t>& threadNodes);
+
+// Queues perft_bag() walks, in lexicographic piece order
+std::vector<std::string> bag_queues(unsigned offset, unsigned depth);
+
+// Perft from options.board with options.queue, by default the empty board and I O L J S Z T
+void bench_perft(const PerftOptions& options = {});
+
+// Per-piece and per-kernel timings plus perft over the built-in corpus, or over
+// options.board and options.queue when either is given, as text or JSON
+void bench_suite(const PerftOptions& options);
+
+// Times generate_all against seven generate() calls on the boards of the first plies,
+// with and without move outcomes
+void bench_generate_all(unsigned plies);
+
+// Per-call cost of the vectorized CollisionMap against the scalar construction
+void bench_collision_maps(unsigned plies);
+
+// Checks the flood engine against the worklist and times both on low, messy and high stacks
+void bench_flood(size_t count);
+
+// Checks generate() on NarrowBoard copies against the full boards and times both
+void bench_narrow(size_t count);
+
+// Times the filtered generate() of each Filter against the full list filtered Move
+// by Move, on played and messy boards, checking both give the same moves
+void bench_filter(size_t count);
+
+// Times move_outcomes() against playing every move with do_move to read its
+// MoveInfo, on played and messy boards, checking both agree
+void bench_outcomes(size_t count);
+
+// Time to the first batch of a MoveStream and to drain it against one eager
+// generate() on the worklist engine, checking the batches add up to its moves
+void bench_stream(size_t count);
+
+// Writes the boards of the first options.depth plies and random garbage boards as
+// PackedState records to options.output. False if there is none or the write fails.
+bool bench_pack(const PerftOptions& options);
+
+// Generates the current and hold (or next) piece of every record in options.input
+// on a thread pool, writing counts or move lists to options.output in record order.
+// Records naming no piece are skipped as "invalid". False if a file can't be opened.
+bool bench_batch(const PerftOptions& options);
+
+// Cold and warm cached perft against plain perft, saving the cache to options.cacheFile if set
+void bench_move_cache(const PerftOptions& options);
+
+// Compares every generator, NarrowBoard included, against generate_reference() as exact
+// move sets on random garbage, high and played boards, for every piece with and without force
+bool bench_fuzz(const PerftOptions& options);
+
+// Bag perft from options.board for options.offset or every offset, with the
+// extreme queues of each, or every queue's count with options.divide
+void bench_bag(const PerftOptions& options);
+
+// Perfect clear solver on options.board and options.queue, or with hold on a
+// built-in set of openers when neither is given
+void bench_pc(const PerftOptions& options);
+
+// Beam search from options.board over options.queue for the best first move
+void bench_search(const PerftOptions& options);
+
+// Runs the command read from is, false if it failed
+bool bench(std::istream& is);
 
 } // namespace Cobra
 
@@ -9,7 +9,8 @@
 
 namespace Cobra {
 
-bool Board::obstructed(const Move& move) const {
+template<typename W>
+bool BasicBoard<W>::obstructed(const Move& move) const {
     const PieceCoordinates pc = move.cells();
     return obstructed(pc[0])
         || obstructed(pc[1])
@@ -17,37 +18,110 @@ bool Board::obstructed(const Move& move) const {
         || obstructed(pc[3]);
 }
 
-bool Board::empty() const {
-    return std::all_of(std::begin(col), std::end(col), [](Bitboard b) { return b == 0; });
+template<typename W>
+bool BasicBoard<W>::empty() const {
+    return std::all_of(std::begin(col), std::end(col), [](W b) { return b == 0; });
 }
 
-Bitboard Board::line_clears() const {
-    Bitboard result = col[0];
+template<typename W>
+W BasicBoard<W>::line_clears() const {
+    W result = col[0];
     for (int x = 1; x < COL_NB && result; ++x)
         result &= col[x];
     return result;
 }
 
-void Board::clear() {
+template<typename W>
+Key BasicBoard<W>::key() const {
+    Key k = 0;
+    for (int x = 0; x < COL_NB; ++x)
+        k ^= Zobrist::column(x, col[x]);
+    return k;
+}
+
+template<typename W>
+void BasicBoard<W>::clear() {
     __builtin_memset(col, 0, sizeof(col));
 }
 
-void Board::clear_lines(Bitboard l) {
+template<typename W>
+void BasicBoard<W>::clear_lines(W l) {
     assert(l);
     do {
-        const Bitboard mask = ~((l & -l) - 1);
+        const W mask = ~((l & -l) - 1);
         for (auto& c : col)
             c = c ^ ((c ^ (c >> 1)) & mask);
     } while ((l = (l & (l - 1)) >> 1));
 }
 
-void Board::place(const Move& move) {
+template<typename W>
+void BasicBoard<W>::unclear_lines(W l) {
+    assert(l);
+    // Rows are reinserted bottom up, so each index is already in pre-clear coordinates
+    do {
+        const W below = (l & -l) - 1;
+        for (auto& c : col)
+            c = (c & below) | ((c & ~below) << 1) | (l & -l);
+    } while ((l &= l - 1));
+}
+
+template<typename W>
+void BasicBoard<W>::place(const Move& move) {
     const PieceCoordinates pc = move.cells();
     for (size_t i = 0; i < 4; ++i)
-        col[pc[i].x] |= bb(pc[i].y);
+        col[pc[i].x] |= bb<W>(pc[i].y);
 }
 
-std::string Board::to_string() const {
+template<typename W>
+void BasicBoard<W>::remove(const Move& move) {
+    const PieceCoordinates pc = move.cells();
+    for (size_t i = 0; i < 4; ++i)
+        col[pc[i].x] &= ~bb<W>(pc[i].y);
+}
+
+template<typename W>
+bool BasicBoard<W>::set(const std::string& rows) {
+    clear();
+    const int height = static_cast<int>(std::count(rows.begin(), rows.end(), '/')) + !rows.empty();
+    if (height > ROWS)
+        return false;
+
+    int y = height - 1, x = 0;
+    for (const char c : rows) {
+        if (c == '/') {
+            --y;
+            x = 0;
+            continue;
+        }
+        if (x >= COL_NB)
+            return false;
+        if (c == '#' || c == 'x')
+            col[x] |= bb<W>(y);
+        else if (c != '.' && c != '_')
+            return false;
+        ++x;
+    }
+    return true;
+}
+
+template<typename W>
+std::string BasicBoard<W>::rows() const {
+    W filled = 0;
+    for (const auto& c : col)
+        filled |= c;
+
+    std::string output;
+    for (int y = bitlen(filled) - 1; y >= 0; --y) {
+        for (const auto& c : col)
+            output += (c & bb<W>(y) ? '#' : '.');
+        if (y)
+            output += '/';
+    }
+    return output;
+}
+
+template<typename W>
+std::string BasicBoard<W>::to_string() const {
     constexpr int lines = 20;
     std::string output;
     output.reserve((lines + 1) * 86 + 44);
@@ -55,14 +129,15 @@ std::string Board::to_string() const {
     for (int y = lines; y >= 0; --y) {
         for (const auto& c : col) {
             output += " | ";
-            output += (c & bb(y) ? '#' : ' ');
+            output += (c & bb<W>(y) ? '#' : ' ');
         }
         output += " |\n +---+---+---+---+---+---+---+---+---+---+\n";
     }
     return output;
 }
 
-std::string Board::to_string(const Move& move) const {
+template<typename W>
+std::string BasicBoard<W>::to_string(const Move& move) const {
     std::string output = to_string();
     if (!obstructed(move)) {
         constexpr int lines = 20;
@@ -77,6 +152,9 @@ std::string Board::to_string(const Move& move) const {
     return output;
 }
 
+template class BasicBoard<Bitboard>;
+template class BasicBoard<uint32_t>;
+
 int MoveInfo::lines_sent(const double multiplier) const {
     if (!clear)
         return 0;
@@ -103,33 +181,103 @@ int MoveInfo::lines_sent(const double multiplier) const {
     return static_cast<int>(lines * multiplier) + static_cast<int>(pc * 10 * multiplier);
 }
 
-void State::init() {
+template<typename W>
+void BasicState<W>::init() {
     board.clear();
     hold = NO_PIECE;
     b2b = combo = 0;
+    key = compute_key();
+}
+
+template<typename W>
+Key BasicState<W>::compute_key() const {
+    return board.key() ^ Zobrist::hold(hold) ^ Zobrist::b2b(b2b) ^ Zobrist::combo(combo);
 }
 
-MoveInfo State::do_move(const Move& move) {
+template<typename W>
+void BasicState<W>::set_hold(const Piece p) {
+    assert(is_ok(p) || p == NO_PIECE);
+    key ^= Zobrist::hold(hold) ^ Zobrist::hold(p);
+    hold = p;
+}
+
+template<typename W>
+MoveInfo BasicState<W>::do_move(const Move& move) {
+    UndoInfo undo;
+    return do_move(move, undo);
+}
+
+template<typename W>
+MoveInfo BasicState<W>::do_move(const Move& move, UndoInfo& undo) {
     assert(is_ok(move));
     assert(!board.obstructed(move));
+    assert(key == compute_key());
+
+    constexpr unsigned allColumns = (1U << COL_NB) - 1;
+    const PieceCoordinates pc = move.cells();
+    unsigned touched = 0;
+    for (size_t i = 0; i < 4; ++i)
+        touched |= 1U << pc[i].x;
+
+    undo = UndoInfo{key, 0, move, hold, b2b, combo};
+
+    Key k = key ^ Zobrist::b2b(b2b) ^ Zobrist::combo(combo);
+    auto update = [&](unsigned cols) {
+        for (; cols; cols &= cols - 1)
+            k ^= Zobrist::column(ctz(cols), board[ctz(cols)]);
+    };
 
+    update(touched);
     board.place(move);
+
+    MoveInfo info{move.piece(), NO_SPIN, 0, 0, 0, false};
     const Bitboard clears = board.line_clears();
     if (!clears)
-        return MoveInfo{move.piece(), NO_SPIN, 0, 0, combo = 0, false};
-
-    board.clear_lines(clears);
-    const int clearCount = popcount(clears);
-    const SpinType spin = move.spin();
-
-    return MoveInfo{
-        move.piece(),
-        spin,
-        clearCount,
-        b2b = (spin || clearCount == 4) ? b2b + 1 : 0,
-        ++combo,
-        board.empty()
-    };
+        combo = 0;
+    else {
+        // Every column shifts, so the untouched ones are rehashed as well
+        update(allColumns & ~touched);
+        board.clear_lines(static_cast<W>(clears));
+        undo.clears = clears;
+        touched = allColumns;
+
+        info.spin = move.spin();
+        info.clear = popcount(clears);
+        info.b2b = b2b = static_cast<int16_t>((info.spin || info.clear == 4) ? b2b + 1 : 0);
+        info.combo = ++combo;
+        info.pc = board.empty();
+    }
+
+    update(touched);
+    key = k ^ Zobrist::b2b(b2b) ^ Zobrist::combo(combo);
+    assert(key == compute_key());
+
+    return info;
+}
+
+template<typename W>
+void BasicState<W>::undo_move(const UndoInfo& undo) {
+    if (undo.clears)
+        board.unclear_lines(static_cast<W>(undo.clears));
+    board.remove(undo.move);
+
+    hold = undo.hold;
+    b2b = undo.b2b;
+    combo = undo.combo;
+    key = undo.key;
+    assert(key == compute_key());
+}
+
+template<typename W>
+bool BasicState<W>::fits(const Move& move) const {
+    const PieceCoordinates pc = move.cells();
+    for (size_t i = 0; i < 4; ++i)
+        if (pc[i].y >= BasicBoard<W>::ROWS)
+            return false;
+    return true;
 }
 
+template struct BasicState<Bitboard>;
+template struct BasicState<uint32_t>;
+
 } // namespace Cobra
\ No newline at end of file
@@ -9,33 +9,99 @@
 
 namespace Cobra {
 
-class Board {
+namespace Zobrist {
+
+// Finalizer of splitmix64, used both to seed the tables and to hash column contents
+constexpr Key mix(Key k) {
+    k = (k ^ (k >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    k = (k ^ (k >> 27)) * 0x94d049bb133111ebULL;
+    return k ^ (k >> 31);
+}
+
+constexpr Key seed(const int i) {
+    return mix(0x9e3779b97f4a7c15ULL * static_cast<Key>(i + 1));
+}
+
+// Columns are hashed as a whole rather than cell by cell, so the row shifts of a
+// line clear cost one mix per column instead of one xor per moved cell.
+constexpr Key column(const int x, const Bitboard c) {
+    return mix(c ^ seed(x));
+}
+
+constexpr Key hold(const Piece p) {
+    return p == NO_PIECE ? 0 : seed(COL_NB + p);
+}
+
+constexpr Key b2b(const int v) {
+    return mix(static_cast<Key>(static_cast<uint16_t>(v)) ^ seed(COL_NB + PIECE_NB));
+}
+
+constexpr Key combo(const int v) {
+    return mix(static_cast<Key>(static_cast<uint16_t>(v)) ^ seed(COL_NB + PIECE_NB + 1));
+}
+
+// Piece p at index i of the remaining queue
+constexpr Key queue(const int i, const Piece p) {
+    return seed(COL_NB + PIECE_NB + 2 + i * PIECE_NB + p);
+}
+
+} // namespace Zobrist
+
+// Columns of W words, bit y of column x for the cell (x, y). Board is the full
+// height; NarrowBoard keeps 32 rows in half the space, for stacks known to be low.
+template<typename W>
+class BasicBoard {
 private:
-    Bitboard col[COL_NB];
+    W col[COL_NB];
 
 public:
-    bool occupied(const int x, const int y) const { return col[x] & bb(y); }
+    static constexpr int ROWS = static_cast<int>(sizeof(W) * 8);
+
+    bool occupied(const int x, const int y) const { return col[x] & bb<W>(y); }
     bool occupied(const Coordinates& c) const { return occupied(c.x, c.y); }
-    bool obstructed(const int x, const int y) const { return !is_ok_x(x) || !is_ok_y(y) || occupied(x, y); }
+    bool obstructed(const int x, const int y) const { return !is_ok_x(x) || y < 0 || y >= ROWS || occupied(x, y); }
     bool obstructed(const Coordinates& c) const { return obstructed(c.x, c.y); }
     bool obstructed(const Move& move) const;
 
-    constexpr Bitboard& operator[](const int x) const {
+    constexpr W& operator[](const int x) const {
         assert(is_ok_x(x));
-        return const_cast<Bitboard&>(col[x]);
+        return const_cast<W&>(col[x]);
     }
 
     bool empty() const;
-    Bitboard line_clears() const;
+    W line_clears() const;
+    Key key() const;
 
     void clear();
-    void clear_lines(Bitboard l);
+    void clear_lines(W l);
+    void unclear_lines(W l);
     void place(const Move& move);
+    void remove(const Move& move);
+
+    // Rows from the top down separated by '/', '#' or 'x' for a filled cell and
+    // '.' or '_' for an empty one; short rows are padded with empty cells
+    bool set(const std::string& rows);
+    std::string rows() const;
+
+    // Copy of b, false if b has a cell at or above ROWS
+    template<typename W1>
+    bool set(const BasicBoard<W1>& b) {
+        for (int x = 0; x < COL_NB; ++x) {
+            if constexpr (sizeof(W1) > sizeof(W))
+                if (b[x] >> ROWS)
+                    return false;
+            col[x] = static_cast<W>(b[x]);
+        }
+        return true;
+    }
 
     std::string to_string() const;
     std::string to_string(const Move& move) const;
 };
 
+using Board = BasicBoard<Bitboard>;
+using NarrowBoard = BasicBoard<uint32_t>;
+
 struct MoveInfo {
     Piece piece;
     SpinType spin;
@@ -47,16 +113,53 @@ struct MoveInfo {
     int lines_sent(double multiplier = 1.0) const;
 };
 
-struct State {
-    Board board;
+// Everything do_move overwrites, so undo_move can restore it without a State copy
+struct UndoInfo {
+    Key key;
+    Bitboard clears;
+    Move move;
+    Piece hold;
+    int16_t b2b;
+    int16_t combo;
+};
+
+// Keys hash column contents, not words, so the same position has the same key
+// at either width and one TT serves both
+template<typename W>
+struct BasicState {
+    BasicBoard<W> board;
     Piece hold;
     int16_t b2b;
     int16_t combo;
+    Key key;
 
     void init();
     MoveInfo do_move(const Move& move);
+    MoveInfo do_move(const Move& move, UndoInfo& undo);
+    void undo_move(const UndoInfo& undo);
+    void set_hold(Piece p);
+
+    // Whether every cell of move is below the board's ROWS, which do_move requires
+    bool fits(const Move& move) const;
+
+    // Copy of s, false if its board doesn't fit
+    template<typename W1>
+    bool set(const BasicState<W1>& s) {
+        if (!board.set(s.board))
+            return false;
+        hold = s.hold;
+        b2b = s.b2b;
+        combo = s.combo;
+        key = s.key;
+        return true;
+    }
+
+    Key compute_key() const;
 };
 
+using State = BasicState<Bitboard>;
+using NarrowState = BasicState<uint32_t>;
+
 } // namespace Cobra
 
 #endif // BOARD_H
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "cache.hpp"
+#include "board.hpp"
+#include "header.hpp"
+#include "movegen.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Cobra {
+
+namespace {
+
+constexpr uint64_t CACHE_MAGIC = 0x31454843414d4243ULL; // "CBMACHE1" in little endian
+
+struct FileHeader {
+    uint64_t magic;
+    uint64_t slots;
+    uint64_t moves;
+};
+
+} // namespace
+
+const MoveCache::Entry* MoveCache::Layer::find(const Key key) const {
+    if (!slots)
+        return nullptr;
+    for (size_t i = index(key, slots); entries[i].used; i = i + 1 == slots ? 0 : i + 1)
+        if (entries[i].key == key)
+            return &entries[i];
+    return nullptr;
+}
+
+MoveCache::MoveCache(const size_t slots) : capacity(slots) {
+    assert(slots > 0);
+}
+
+MoveCache::~MoveCache() {
+    unmap();
+}
+
+bool MoveCache::cacheable(const Board& b) {
+    bool result = true;
+    for (int x = 0; x < COL_NB; ++x)
+        result &= !(b[x] & (b[x] + 1)) && b[x] != ~0ULL;
+    return result;
+}
+
+Key MoveCache::profile(const Board& b, const Piece p, const bool force) {
+    assert(cacheable(b));
+    Key key = 0;
+    for (int x = 0; x < COL_NB; ++x)
+        key |= static_cast<Key>(bitlen(b[x])) << (6 * x);
+    return key | static_cast<Key>(p) << 60 | static_cast<Key>(force) << 63;
+}
+
+const MoveCache::Entry* MoveCache::find(const Key key) const {
+    if (const Entry* e = file.find(key))
+        return e;
+    return Layer{entries.data(), pool.data(), entries.size()}.find(key);
+}
+
+void MoveCache::insert(const Key key, const Move* first, const size_t count) {
+    if (entries.empty())
+        entries.assign(capacity, Entry{});
+
+    // Keep a quarter of the slots free so probe sequences stay short
+    if (4 * (used + 1) > 3 * entries.size())
+        return;
+
+    size_t i = index(key, entries.size());
+    while (entries[i].used)
+        i = i + 1 == entries.size() ? 0 : i + 1;
+
+    entries[i] = Entry{key, static_cast<uint32_t>(pool.size()), static_cast<uint16_t>(count), 1};
+    pool.insert(pool.end(), first, first + count);
+    ++used;
+}
+
+Move* MoveCache::generate(const Board& b, Move* moves, const Piece p, const bool force) {
+    if (!cacheable(b))
+        return Cobra::generate(b, moves, p, force);
+
+    const Key key = profile(b, p, force);
+    if (const Entry* e = find(key)) {
+        ++hits;
+        const Move* const source = e >= file.entries && e < file.entries + file.slots ? file.moves : pool.data();
+        std::memcpy(moves, source + e->offset, e->count * sizeof(Move));
+        return moves + e->count;
+    }
+
+    ++misses;
+    Move* const last = Cobra::generate(b, moves, p, force);
+    insert(key, moves, static_cast<size_t>(last - moves));
+    return last;
+}
+
+size_t MoveCache::count_moves(const Board& b, const Piece p, const bool force) {
+    if (!cacheable(b))
+        return Cobra::count_moves(b, p, force);
+
+    if (const Entry* e = find(profile(b, p, force))) {
+        ++hits;
+        return e->count;
+    }
+
+    // Fill the entry so the next board with this profile is a hit
+    Move moves[MAX_MOVES];
+    return static_cast<size_t>(generate(b, moves, p, force) - moves);
+}
+
+size_t MoveCache::size() const {
+    size_t result = used;
+    for (size_t i = 0; i < file.slots; ++i)
+        result += file.entries[i].used;
+    return result;
+}
+
+void MoveCache::unmap() {
+    if (mapping)
+        munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+    file = Layer{};
+}
+
+void MoveCache::share(const MoveCache* source) {
+    unmap();
+    if (source)
+        file = source->file;
+}
+
+bool MoveCache::load(const std::string& path) {
+    unmap();
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+        close(fd);
+        return false;
+    }
+
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* const data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    // Sizes are bounded before they are multiplied so a bad header can't wrap
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    const size_t body = size - sizeof(FileHeader);
+    bool valid = header.magic == CACHE_MAGIC && header.slots && header.slots <= body / sizeof(Entry)
+              && header.moves <= body / sizeof(Move)
+              && body == header.slots * sizeof(Entry) + header.moves * sizeof(Move);
+
+    // Every list must lie in the move pool and fit the callers' MAX_MOVES buffers,
+    // and a free slot must remain to end the probe sequences
+    const char* const bytes = static_cast<const char*>(data);
+    const Entry* const table = reinterpret_cast<const Entry*>(bytes + sizeof(FileHeader));
+    size_t usedSlots = 0;
+    for (size_t i = 0; valid && i < header.slots; ++i)
+        if (table[i].used) {
+            valid = table[i].count < MAX_MOVES
+                 && uint64_t(table[i].offset) + table[i].count <= header.moves;
+            ++usedSlots;
+        }
+    valid &= usedSlots < header.slots;
+
+    if (!valid) {
+        munmap(data, size);
+        return false;
+    }
+
+    mapping = data;
+    mappingSize = size;
+    file.entries = table;
+    file.moves = reinterpret_cast<const Move*>(bytes + sizeof(FileHeader) + header.slots * sizeof(Entry));
+    file.slots = header.slots;
+    return true;
+}
+
+bool MoveCache::save(const std::string& path) const {
+    // Both layers are merged into one table at half load
+    const size_t count = size();
+    const size_t slots = count ? 2 * count : 1;
+    std::vector<Entry> table(slots, Entry{});
+    std::vector<Move> moves;
+
+    auto add = [&](const Layer& layer) {
+        for (size_t i = 0; i < layer.slots; ++i) {
+            const Entry& e = layer.entries[i];
+            if (!e.used)
+                continue;
+            size_t j = index(e.key, slots);
+            while (table[j].used)
+                j = j + 1 == slots ? 0 : j + 1;
+            table[j] = Entry{e.key, static_cast<uint32_t>(moves.size()), e.count, 1};
+            moves.insert(moves.end(), layer.moves + e.offset, layer.moves + e.offset + e.count);
+        }
+    };
+    add(file);
+    add(Layer{entries.data(), pool.data(), entries.size()});
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    const FileHeader header{CACHE_MAGIC, slots, moves.size()};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(slots * sizeof(Entry)));
+    out.write(reinterpret_cast<const char*>(moves.data()), static_cast<std::streamsize>(moves.size() * sizeof(Move)));
+    return static_cast<bool>(out);
+}
+
+} // namespace Cobra
\ No newline at end of file
@@ -0,0 +1,90 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "board.hpp"
+#include "header.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Cobra {
+
+// Move lists of overhang-free boards. Every column of such a board is solid up
+// to its height, so the heights together with the piece and the force flag are
+// an exact key, and a list generated once replays for any board with the same
+// profile, spins included. Not synchronized, use one cache per thread.
+class MoveCache {
+private:
+    struct Entry {
+        Key key;
+        uint32_t offset;
+        uint16_t count;
+        uint16_t used;
+    };
+
+    static_assert(sizeof(Entry) == 16);
+
+    // Open addressing table with the moves of its entries in one pool
+    struct Layer {
+        const Entry* entries = nullptr;
+        const Move* moves = nullptr;
+        size_t slots = 0;
+
+        const Entry* find(Key key) const;
+    };
+
+    std::vector<Entry> entries; // capacity slots, allocated by the first insert
+    std::vector<Move> pool;
+    size_t capacity;
+    size_t used = 0;
+
+    // Read-only layer mapped from a file by load()
+    Layer file;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    static size_t index(const Key key, const size_t slots) {
+        return static_cast<size_t>((static_cast<unsigned __int128>(Zobrist::mix(key)) * slots) >> 64);
+    }
+
+    const Entry* find(Key key) const;
+    void insert(Key key, const Move* first, size_t count);
+    void unmap();
+
+public:
+    explicit MoveCache(size_t slots = size_t(1) << 20);
+    ~MoveCache();
+
+    MoveCache(const MoveCache&) = delete;
+    MoveCache& operator=(const MoveCache&) = delete;
+
+    // Whether every column is solid from the floor, the cheap test guarding the cache
+    static bool cacheable(const Board& b);
+    static Key profile(const Board& b, Piece p, bool force);
+
+    // Same results as generate() and count_moves(), served from the cache when the board allows it
+    Move* generate(const Board& b, Move* moves, Piece p, bool force = false);
+    size_t count_moves(const Board& b, Piece p, bool force = false);
+
+    // Maps a file written by save() as a read-only layer in front of the table
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    // Serves the file layer of source (none if null) without mapping it again,
+    // source must stay alive and keep its mapping while this cache is used
+    void share(const MoveCache* source);
+
+    bool mapped() const { return file.slots; }
+    size_t size() const;
+    uint64_t hit_count() const { return hits; }
+    uint64_t miss_count() const { return misses; }
+};
+
+} // namespace Cobra
+
+#endif // CACHE_H
\ No newline at end of file
@@ -17,7 +17,7 @@ constexpr int SPAWN_COL = 4;
 constexpr int SPAWN_ROW = 21;
 
 template<Piece p, Rotation r>
-consteval bool in_bounds(const int x) {
+constexpr bool in_bounds(const int x) {
     static_assert(is_ok(p));
     static_assert(is_ok(r));
     constexpr PieceCoordinates pc = piece_table(p, r);
@@ -48,7 +48,7 @@ constexpr Coordinates canonical_offset(const Rotation r) {
         if (r == SOUTH)
             return {1, 0};
         if (r == WEST)
-            return {0, 1}; 
+            return {0, -1};
     }
     if constexpr (p == S || p == Z) {
         if (r == WEST)
@@ -59,19 +59,153 @@ constexpr Coordinates canonical_offset(const Rotation r) {
     return {0, 0};
 }
 
-template<Piece p>
+// Columns are processed as vector lanes of one column word each, a 256-bit
+// group at a time: four 64-bit columns, or eight for a NarrowBoard. With AVX2
+// a group is a single register, otherwise the compiler lowers it to SSE2 pairs
+// or scalars.
+template<typename W>
+struct LaneVector;
+
+template<>
+struct LaneVector<uint64_t> {
+    using type = uint64_t __attribute__((vector_size(32)));
+};
+
+template<>
+struct LaneVector<uint32_t> {
+    using type = uint32_t __attribute__((vector_size(32)));
+};
+
+template<typename W>
+struct LaneLayout {
+    static constexpr int LANE_NB = static_cast<int>(32 / sizeof(W));
+    static constexpr int GROUP_NB = (COL_NB + LANE_NB - 1) / LANE_NB;
+    // Row stride of the rotation-major maps, padded to whole groups
+    static constexpr int COL_STRIDE = GROUP_NB * LANE_NB;
+
+    using Lanes = typename LaneVector<W>::type;
+};
+
+constexpr int LANE_NB = LaneLayout<Bitboard>::LANE_NB;
+constexpr int GROUP_NB = LaneLayout<Bitboard>::GROUP_NB;
+constexpr int COL_STRIDE = LaneLayout<Bitboard>::COL_STRIDE;
+
+using Lanes = LaneLayout<Bitboard>::Lanes;
+
+// Board columns as lane groups with a wall group on each side
+template<typename W>
+struct ColumnLanes {
+    using Layout = LaneLayout<W>;
+    using Lanes = typename Layout::Lanes;
+
+    Lanes group[Layout::GROUP_NB + 2];
+
+    explicit ColumnLanes(const BasicBoard<W>& b) {
+        if constexpr (sizeof(W) == 8) {
+            static_assert(COL_NB == 10 && Layout::GROUP_NB == 3);
+            using Half = Bitboard __attribute__((vector_size(2 * sizeof(Bitboard))));
+            constexpr Half wall2 = {~0ULL, ~0ULL};
+            Lanes v0, v1;
+            Half v2;
+            __builtin_memcpy(&v0, &b[0], sizeof(v0));
+            __builtin_memcpy(&v1, &b[4], sizeof(v1));
+            __builtin_memcpy(&v2, &b[8], sizeof(v2));
+            group[0] = group[Layout::GROUP_NB + 1] = ~Lanes{};
+            group[1] = v0;
+            group[2] = v1;
+            group[3] = __builtin_shufflevector(v2, wall2, 0, 1, 2, 3);
+        } else {
+            alignas(32) W cols[(Layout::GROUP_NB + 2) * Layout::LANE_NB];
+            for (W& c : cols)
+                c = ~W(0);
+            __builtin_memcpy(&cols[Layout::LANE_NB], &b[0], COL_NB * sizeof(W));
+            __builtin_memcpy(group, cols, sizeof(group));
+        }
+    }
+
+    // Columns [LANE_NB * g + dx, LANE_NB * g + dx + LANE_NB), walls outside the board
+    template<int dx, int g>
+    void shifted(Lanes& dst) const {
+        static_assert(dx > -Layout::LANE_NB && dx < Layout::LANE_NB);
+        constexpr auto lanes = std::make_index_sequence<Layout::LANE_NB>{};
+        if constexpr (dx < 0)
+            select<Layout::LANE_NB + dx>(dst, group[g], group[g + 1], lanes);
+        else if constexpr (dx > 0)
+            select<dx>(dst, group[g + 1], group[g + 2], lanes);
+        else
+            dst = group[g + 1];
+    }
+
+private:
+    // Lanes [first, first + LANE_NB) of a followed by b. Vectors never cross a
+    // call by value, which without AVX would be an ABI change (-Wpsabi).
+    template<int first, size_t... is>
+    static void select(Lanes& dst, const Lanes& a, const Lanes& b, std::index_sequence<is...>) {
+        dst = __builtin_shufflevector(a, b, (first + static_cast<int>(is))...);
+    }
+};
+
+// A row of lane groups covering every column
+using LaneRow = Lanes[GROUP_NB];
+
+inline void load_row(LaneRow& dst, const Bitboard* src) {
+    __builtin_memcpy(&dst, src, sizeof(LaneRow));
+}
+
+// Group g of v moved right by dx columns (lane x holds column x - dx), zero
+// filled from outside the board
+template<int dx, int g>
+void shift_row(Lanes& dst, const LaneRow& v) {
+    static_assert(dx > -LANE_NB && dx < LANE_NB);
+    constexpr Lanes zero{};
+    if constexpr (dx > 0) {
+        if constexpr (g > 0)
+            dst = __builtin_shufflevector(v[g - 1], v[g], 4 - dx, 5 - dx, 6 - dx, 7 - dx);
+        else
+            dst = __builtin_shufflevector(zero, v[g], 4 - dx, 5 - dx, 6 - dx, 7 - dx);
+    }
+    else if constexpr (dx < 0) {
+        if constexpr (g + 1 < GROUP_NB)
+            dst = __builtin_shufflevector(v[g], v[g + 1], -dx, 1 - dx, 2 - dx, 3 - dx);
+        else
+            dst = __builtin_shufflevector(v[g], zero, -dx, 1 - dx, 2 - dx, 3 - dx);
+    }
+    else
+        dst = v[g];
+}
+
+template<Piece p, typename W = Bitboard>
 class CollisionMap {
 private:
+    using Layout = LaneLayout<W>;
+    using Lanes = typename Layout::Lanes;
+    static constexpr int LANE_NB = Layout::LANE_NB;
+    static constexpr int GROUP_NB = Layout::GROUP_NB;
+    static constexpr int COL_STRIDE = Layout::COL_STRIDE;
+
     static constexpr int canonicalSize = canonical_size<p>();
-    Bitboard board[COL_NB][canonicalSize];
+    alignas(32) W board[canonicalSize][COL_STRIDE];
 
-public:
-    explicit CollisionMap(const Board& b) {
+    struct Scalar {};
+
+    // Positions with a cell outside the board collide everywhere
+    static constexpr auto walls = []{
+        std::array<std::array<W, COL_STRIDE>, canonicalSize> result{};
+        [&]<size_t... rs>(std::index_sequence<rs...>) {
+            ([&]{
+                for (int x = 0; x < COL_STRIDE; ++x)
+                    result[rs][x] = in_bounds<p, static_cast<Rotation>(rs)>(x) ? 0 : ~W(0);
+            }(), ...);
+        }(std::make_index_sequence<canonicalSize>{});
+        return result;
+    }();
+
+    CollisionMap(const BasicBoard<W>& b, Scalar) {
         auto init = [&]<int x, Rotation r>{
             if constexpr (!in_bounds<p, r>(x))
-                return ~0ULL;
+                return ~W(0);
             constexpr PieceCoordinates pc = piece_table(p, r);
-            Bitboard result = 0;
+            W result = 0;
             for (size_t i = 0; i < 4; ++i)
                 result |= (pc[i].y < 0) ? ~(~b[x + pc[i].x] << -pc[i].y) : (b[x + pc[i].x] >> pc[i].y);
             return result;
@@ -79,7 +213,9 @@ public:
 
         [&]<size_t... xs>(std::index_sequence<xs...>) {
             auto init1 = [&]<Rotation r>{
-                ((board[xs][r] = init.template operator()<xs, r>()), ...);
+                ((board[r][xs] = init.template operator()<xs, r>()), ...);
+                for (int x = COL_NB; x < COL_STRIDE; ++x)
+                    board[r][x] = ~W(0);
             };
 
             [&]<size_t... rs>(std::index_sequence<rs...>) {
@@ -88,9 +224,80 @@ public:
         }(std::make_index_sequence<COL_NB>{});
     }
 
-    const Bitboard* operator[](const int x) const { return board[x]; }
+    template<Rotation r, int g>
+    void build(const ColumnLanes<W>& cols) {
+        constexpr PieceCoordinates pc = piece_table(p, r);
+        Lanes result;
+        __builtin_memcpy(&result, &walls[r][g * LANE_NB], sizeof(result));
+        auto cell = [&]<size_t i>{
+            Lanes v;
+            cols.template shifted<pc[i].x, g>(v);
+            if constexpr (pc[i].y < 0)
+                result |= ~(~v << -pc[i].y);
+            else
+                result |= v >> pc[i].y;
+        };
+        cell.template operator()<0>();
+        cell.template operator()<1>();
+        cell.template operator()<2>();
+        cell.template operator()<3>();
+        __builtin_memcpy(&board[r][g * LANE_NB], &result, sizeof(result));
+    }
+
+    // Calls f<r, g>() for every rotation and group
+    template<typename F>
+    static void for_each_group(F&& f) {
+        [&]<size_t... rs>(std::index_sequence<rs...>) {
+            auto init1 = [&]<Rotation r>{
+                [&]<size_t... gs>(std::index_sequence<gs...>) {
+                    (f.template operator()<r, static_cast<int>(gs)>(), ...);
+                }(std::make_index_sequence<GROUP_NB>{});
+            };
+            (init1.template operator()<static_cast<Rotation>(rs)>(), ...);
+        }(std::make_index_sequence<canonicalSize>{});
+    }
+
+public:
+    // Builds each rotation for all columns at once: every cell of the piece is
+    // a lane shuffle of the column groups followed by a vertical shift.
+    explicit CollisionMap(const BasicBoard<W>& b) : CollisionMap(b, ColumnLanes<W>(b)) {}
+
+    // Same from the columns of b already loaded, shared by the pieces of one board
+    CollisionMap([[maybe_unused]] const BasicBoard<W>& b, const ColumnLanes<W>& cols) {
+        for_each_group([&]<Rotation r, int g>{ build<r, g>(cols); });
+        assert(*this == scalar(b));
+    }
+
+    // Reference construction, one column and rotation at a time
+    static CollisionMap scalar(const BasicBoard<W>& b) { return CollisionMap(b, Scalar{}); }
+
+    bool operator==(const CollisionMap& cm) const {
+        for (int r = 0; r < canonicalSize; ++r)
+            for (int x = 0; x < COL_NB; ++x)
+                if (board[r][x] != cm.board[r][x])
+                    return false;
+        return true;
+    }
 
-    Bitboard operator()(const int x, const Rotation r) const { return board[x][canonical_r<p>(r)]; }
+    W operator()(const int x, const Rotation r) const { return board[canonical_r<p>(r)][x]; }
+
+    // All columns of rotation r, COL_STRIDE entries with obstructed padding
+    const W* row(const Rotation r) const { return board[canonical_r<p>(r)]; }
+};
+
+// Column union and stack height, shared by every piece generated on one board
+struct BoardInfo {
+    int height;
+    bool slow; // The spawn area may be obstructed, so the surface shortcut is unsafe
+
+    template<typename W>
+    explicit BoardInfo(const BasicBoard<W>& b) {
+        W m = b[0];
+        for (int i = 1; i < COL_NB; ++i)
+            m |= b[i];
+        height = bitlen(m);
+        slow = height > SPAWN_ROW - 3;
+    }
 };
 
 enum Direction {
@@ -114,6 +321,74 @@ template<size_t N>
 using OffsetsRot = std::array<Offsets<N>, ROTATION_NB>;
 
 
+// T corner bitboards: [x][0] has the rows where a T centred in column x has
+// three corners filled, [x][1 + r] the subset where both corners in front of
+// rotation r are filled (full rather than mini spins)
+template<typename W>
+class BasicSpinMap {
+private:
+    W map[COL_NB][1 + ROTATION_NB] = {};
+
+    template<int x>
+    void init(const BasicBoard<W>& b) {
+        const W corners[] = {
+            x > 0 ? b[x - 1] >> 1 : ~W(0),
+            x < 9 ? b[x + 1] >> 1 : ~W(0),
+            x < 9 ? (b[x + 1] << 1 | 1) : ~W(0),
+            x > 0 ? (b[x - 1] << 1 | 1) : ~W(0)
+        };
+
+        const W spins = (
+            (corners[0] & corners[1] & (corners[2] | corners[3])) |
+            (corners[2] & corners[3] & (corners[0] | corners[1]))
+        );
+
+        map[x][0] = spins;
+        auto process = [&]<Rotation r>{
+            map[x][1 + r] = spins && in_bounds<T, r>(x) ? spins & corners[r] & corners[rotate<Direction::CW>(r)] : 0;
+        };
+
+        [&]<size_t... rs>(std::index_sequence<rs...>) {
+            (process.template operator()<static_cast<Rotation>(rs)>(), ...);
+        }(std::make_index_sequence<ROTATION_NB>());
+    }
+
+public:
+    BasicSpinMap() = default;
+
+    explicit BasicSpinMap(const BasicBoard<W>& b) {
+        [&]<size_t... xs>(std::index_sequence<xs...>) {
+            (init<xs>(b), ...);
+        }(std::make_index_sequence<COL_NB>());
+    }
+
+    const W* operator[](const int x) const { return map[x]; }
+
+    // Whether a T can come to rest on any spin square, otherwise the plain T generator suffices
+    bool any(const CollisionMap<T, W>& cm) const {
+        bool result = false;
+        auto init = [&]<int x>{
+            if (!map[x][0])
+                return;
+            auto process = [&]<Rotation r>{
+                if (in_bounds<T, r>(x))
+                    result |= map[x][0] & ~cm(x, r) & ((cm(x, r) << 1) | 1);
+            };
+
+            [&]<size_t... rs>(std::index_sequence<rs...>) {
+                (process.template operator()<static_cast<Rotation>(rs)>(), ...);
+            }(std::make_index_sequence<ROTATION_NB>());
+        };
+
+        [&]<size_t... xs>(std::index_sequence<xs...>) {
+            (init.template operator()<xs>(), ...);
+        }(std::make_index_sequence<COL_NB>());
+        return result;
+    }
+};
+
+using SpinMap = BasicSpinMap<Bitboard>;
+
 #define e Coordinates
 constexpr OffsetsRot<5> kicks[2][Direction_NB] = {
     { // LJSZT
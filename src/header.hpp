@@ -11,6 +11,16 @@ namespace Cobra {
 // Types
 
 using Bitboard = uint64_t;
+using Key = uint64_t;
+
+// With dispatch=yes the build targets baseline x86-64 and the hot entry points
+// get x86-64-v3 (AVX2, BMI2) and v4 (AVX-512) clones as well, one of which the
+// loader picks by cpuid. flatten inlines each call tree into every clone.
+#ifdef USE_DISPATCH
+#define DISPATCH __attribute__((target_clones("default", "arch=x86-64-v3", "arch=x86-64-v4"), flatten))
+#else
+#define DISPATCH
+#endif
 
 constexpr int COL_NB = 10;
 constexpr int ROW_NB = 64;
@@ -221,6 +231,10 @@ constexpr int clz(const Bitboard v) {
     return v ? __builtin_clzll(v) : 64;
 }
 
+constexpr int clz(const uint32_t v) {
+    return v ? __builtin_clz(v) : 32;
+}
+
 template <typename T>
 constexpr int ctz(const T v) {
     assert(v);
@@ -231,18 +245,25 @@ constexpr int popcount(const Bitboard v) {
     return __builtin_popcountll(v);
 }
 
-constexpr int bitlen(const Bitboard v){
-    return 64 - clz(v);
+constexpr int popcount(const uint32_t v) {
+    return __builtin_popcount(v);
+}
+
+template<typename W>
+constexpr int bitlen(const W v){
+    return static_cast<int>(sizeof(W) * 8) - clz(v);
 }
 
-constexpr Bitboard bb(const int v){
+template<typename W = Bitboard>
+constexpr W bb(const int v){
     assert(v >= 0);
-    return 1ULL << v;
+    return W(1) << v;
 }
 
-constexpr Bitboard bb_low(const int v){
+template<typename W = Bitboard>
+constexpr W bb_low(const int v){
     assert(v >= 0);
-    return (1ULL << v) - 1;
+    return (W(1) << v) - 1;
 }
 
 } // namespace Cobra
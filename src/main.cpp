@@ -1,7 +1,13 @@
 #include "bench.hpp"
 
-int main() {
-    Cobra::bench_perft();
+#include <sstream>
+#include <string>
 
-    return 0;
+int main(int argc, char* argv[]) {
+    std::string args;
+    for (int i = 1; i < argc; ++i)
+        args += std::string(argv[i]) + ' ';
+
+    std::istringstream is(args);
+    return Cobra::bench(is) ? 0 : 1;
 }
\ No newline at end of file
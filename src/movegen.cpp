@@ -2,86 +2,122 @@
 #include "gen.hpp"
 #include "header.hpp"
 #include "movegen.hpp"
+#include "stats.hpp"
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
 #include <utility>
+#include <variant>
 
 namespace Cobra {
 
-const Bitboard spinMapDummy[COL_NB][1 + ROTATION_NB] = {};
-
-template<Piece p1>
-Move* generate(Move* moves, const bool slow, const bool force, const Gen::CollisionMap<p1 == TSPIN ? T : p1>& cm, [[maybe_unused]] const Bitboard (&spinMap)[COL_NB][1 + ROTATION_NB] = spinMapDummy) {
-    constexpr Piece p = p1 == TSPIN ? T : p1;
-    constexpr bool checkSpin = p1 == TSPIN;
-    constexpr int canonicalSize = Gen::canonical_size<p>();
-    constexpr int searchSize = p == O ? 1 : ROTATION_NB;
+template<typename W>
+const Gen::BasicSpinMap<W> spinMapDummy;
+
+// Worklist engine, kept in an object so a search can stop between two pops and
+// resume later: start() seeds it from the spawn or the surface, every step()
+// pops one (x, rotation), and finish() writes the T moves, whose spins are only
+// known once nothing is left to search. Moves are counted instead with COUNT.
+// W is the column word of the board the maps were built from
+template<Piece p1, GenType gt, typename W, typename F>
+class Worklist {
+private:
+    static constexpr Piece p = p1 == TSPIN ? T : p1;
+    static constexpr bool checkSpin = p1 == TSPIN;
+    static constexpr int canonicalSize = Gen::canonical_size<p>();
+    static constexpr int searchSize = p == O ? 1 : ROTATION_NB;
     static_assert(is_ok(p));
 
+    const Gen::CollisionMap<p, W>& cm;
+    [[maybe_unused]] const Gen::BasicSpinMap<W>& spinMap;
+    const F& filter;
+
     int total = 0;
+    size_t count = 0;
     Bitboard remaining = 0;
-    Bitboard toSearch[COL_NB][searchSize] = {};
-    Bitboard searched[COL_NB][searchSize];
-    Bitboard moveSet[COL_NB][canonicalSize] = {};
-    Bitboard spinSet[COL_NB][ROTATION_NB][checkSpin ? SPIN_NB : 0] = {};
+    W toSearch[COL_NB][searchSize] = {};
+    W searched[COL_NB][searchSize];
+    W moveSet[COL_NB][canonicalSize] = {};
+    W spinSet[COL_NB][ROTATION_NB][checkSpin ? SPIN_NB : 0] = {};
 
-    auto remaining_index = [](int x, Rotation r) { return bb(x * ROTATION_NB + r); };
+    static Bitboard remaining_index(int x, Rotation r) { return bb(x * ROTATION_NB + r); }
 
-    for (int x = 0; x < COL_NB; ++x)
-        for (int r = 0; r < searchSize; ++r)
-            searched[x][r] = cm(x, static_cast<Rotation>(r));
+public:
+    Worklist(const Gen::CollisionMap<p, W>& c, const F& f, const Gen::BasicSpinMap<W>& sm = spinMapDummy<W>) :
+        cm(c), spinMap(sm), filter(f) {}
 
-    if (slow) {
-        const Bitboard spawn = [&]{
-            if (force) {
-                const Bitboard s = ~cm[Gen::SPAWN_COL][NORTH] & (~0ULL << Gen::SPAWN_ROW);
-                return s & -s;
-            }
-            return ~cm[Gen::SPAWN_COL][NORTH] & bb(Gen::SPAWN_ROW);
-        }();
-        if (!spawn)
-            return moves;
+    bool done() const { return !remaining; }
+    size_t counted() const { return count; }
 
-        toSearch[Gen::SPAWN_COL][NORTH] = spawn;
-        remaining |= remaining_index(Gen::SPAWN_COL, NORTH);
-        if constexpr (checkSpin)
-            spinSet[Gen::SPAWN_COL][NORTH][NO_SPIN] = spawn;
-    } else {
-        auto init = [&]<int x>{
-            auto process = [&]<Rotation r>{
-                if constexpr (!Gen::in_bounds<p, Gen::canonical_r<p>(r)>(x))
-                    return;
+    // Surface placements are written here, unless the board is slow
+    Move* start(Move* moves, const bool slow, const bool force) {
+        for (int x = 0; x < COL_NB; ++x)
+            for (int r = 0; r < searchSize; ++r)
+                searched[x][r] = cm(x, static_cast<Rotation>(r));
+
+        if (slow) {
+            const W spawn = [&]{
+                if (force) {
+                    const W s = ~cm(Gen::SPAWN_COL, NORTH) & (~W(0) << Gen::SPAWN_ROW);
+                    return s & -s;
+                }
+                return ~cm(Gen::SPAWN_COL, NORTH) & bb<W>(Gen::SPAWN_ROW);
+            }();
+            if (!spawn)
+                return moves;
 
-                assert(cm(x, r) != ~0ULL);
-                const int y = bitlen(cm(x, r));
-                const Bitboard surface = bb_low(Gen::SPAWN_ROW) & ~bb_low(y);
+            toSearch[Gen::SPAWN_COL][NORTH] = spawn;
+            remaining |= remaining_index(Gen::SPAWN_COL, NORTH);
+            if constexpr (checkSpin)
+                spinSet[Gen::SPAWN_COL][NORTH][NO_SPIN] = spawn;
+        } else {
+            auto init = [&]<int x>{
+                auto process = [&]<Rotation r>{
+                    if constexpr (!Gen::in_bounds<p, Gen::canonical_r<p>(r)>(x))
+                        return;
+
+                    assert(cm(x, r) != ~W(0));
+                    const int y = bitlen(cm(x, r));
+                    const W surface = bb_low<W>(Gen::SPAWN_ROW) & ~bb_low<W>(y);
+
+                    searched[x][r] |= toSearch[x][r] = surface;
+                    remaining |= remaining_index(x, r);
+                    if constexpr (checkSpin)
+                        spinSet[x][r][NO_SPIN] = surface;
+                    else if constexpr (r < canonicalSize) {
+                        if (filter.template mask<p>(x, r) & bb(y)) {
+                            if constexpr (gt == COUNT)
+                                ++count;
+                            else
+                                *moves++ = Move(p, r, x, y);
+                        }
+                        total += popcount(~cm(x, r) & ((cm(x, r) << 1) | 1)) - 1;
+                    }
+                };
 
-                searched[x][r] |= toSearch[x][r] = surface;
-                remaining |= remaining_index(x, r);
-                if constexpr (checkSpin)
-                    spinSet[x][r][NO_SPIN] = surface;
-                else if constexpr (r < canonicalSize) {
-                    *moves++ = Move(p, r, x, y);
-                    total += popcount(~cm(x, r) & ((cm(x, r) << 1) | 1)) - 1;
-                }
+                [&]<size_t... rs>(std::index_sequence<rs...>) {
+                    (process.template operator()<static_cast<Rotation>(rs)>(), ...);
+                }(std::make_index_sequence<searchSize>());
             };
 
-            [&]<size_t... rs>(std::index_sequence<rs...>) {
-                (process.template operator()<static_cast<Rotation>(rs)>(), ...);
-            }(std::make_index_sequence<searchSize>());
-        };
-
-        [&]<size_t... xs>(std::index_sequence<xs...>) {
-            (init.template operator()<xs>(), ...);
-        }(std::make_index_sequence<COL_NB>());
+            [&]<size_t... xs>(std::index_sequence<xs...>) {
+                (init.template operator()<xs>(), ...);
+            }(std::make_index_sequence<COL_NB>());
 
-        if constexpr (!checkSpin)
-            if (!total)
-                return moves;
+            if constexpr (!checkSpin)
+                if (!total) {
+                    Stats::add(EARLY_EXITS);
+                    remaining = 0;
+                }
+        }
+        return moves;
     }
 
-    while (remaining) {
+    Move* step(Move* moves) {
+        Stats::add(POPS);
         const int index = ctz(remaining);
         const int x = index >> 2;
         const Rotation r = static_cast<Rotation>(index & 3);
@@ -94,14 +130,15 @@ Move* generate(Move* moves, const bool slow, const bool force, const Gen::Collis
         // Softdrops
         {
             if constexpr (checkSpin) {
-                Bitboard m = (toSearch[x][r] >> 1) & ~cm(x, r);
+                W m = (toSearch[x][r] >> 1) & ~cm(x, r);
                 while ((m & toSearch[x][r]) != m) {
+                    Stats::add(SOFTDROPS);
                     toSearch[x][r] |= m;
                     m |= (m >> 1) & ~cm(x, r);
                 }
                 spinSet[x][r][NO_SPIN] |= m;
             } else {
-                Bitboard m = (toSearch[x][r] >> 1) & ~toSearch[x][r] & ~searched[x][r];
+                W m = (toSearch[x][r] >> 1) & ~toSearch[x][r] & ~searched[x][r];
                 // if (m) {
                 //     const Bitboard m1 = __builtin_bitreverse64(m);
                 //     const Bitboard f = __builtin_bitreverse64(searched[x][r]);
@@ -109,6 +146,7 @@ Move* generate(Move* moves, const bool slow, const bool force, const Gen::Collis
                 // }
                 // Alternative if no/slow bit reverse function (x86 arch):
                 while (m) {
+                    Stats::add(SOFTDROPS);
                     toSearch[x][r] |= m;
                     m = (m >> 1) & ~searched[x][r];
                 }
@@ -121,7 +159,7 @@ Move* generate(Move* moves, const bool slow, const bool force, const Gen::Collis
                 moveSet[x][r] |= toSearch[x][r] & ((cm(x, r) << 1) | 1);
             else {
                 const Rotation r1 = Gen::canonical_r<p>(r);
-                Bitboard m = toSearch[x][r] & ((cm(x, r) << 1) | 1) & ~searched[x][r] & ~moveSet[x][r1];
+                W m = toSearch[x][r] & ((cm(x, r) << 1) | 1) & ~searched[x][r] & ~moveSet[x][r1];
                 if (m) {
                     assert(is_ok(r1));
                     assert(!(m & cm(x, r1)));
@@ -129,12 +167,18 @@ Move* generate(Move* moves, const bool slow, const bool force, const Gen::Collis
 
                     moveSet[x][r1] |= m;
                     total -= popcount(m);
-                    while (m) {
-                        *moves++ = Move(p, r1, x, ctz(m));
-                        m &= m - 1;
-                    }
-                    if (!total)
+                    m &= static_cast<W>(filter.template mask<p>(x, r1));
+                    if constexpr (gt == COUNT)
+                        count += static_cast<size_t>(popcount(m));
+                    else
+                        while (m) {
+                            *moves++ = Move(p, r1, x, ctz(m));
+                            m &= m - 1;
+                        }
+                    if (!total) {
+                        remaining = 0;
                         return moves;
+                    }
                 }
             }
         }
@@ -142,12 +186,13 @@ Move* generate(Move* moves, const bool slow, const bool force, const Gen::Collis
         // Shift
         {
             auto shift = [&](int x1) {
-                const Bitboard m = toSearch[x][r] & ~searched[x1][r];
+                // A shift onto a spin position already searched still leaves it unspun
+                if constexpr (checkSpin)
+                    spinSet[x1][r][NO_SPIN] |= toSearch[x][r] & ~cm(x1, r);
+                const W m = toSearch[x][r] & ~searched[x1][r];
                 if (m) {
                     toSearch[x1][r] |= m;
                     remaining |= remaining_index(x1, r);
-                    if constexpr (checkSpin)
-                        spinSet[x1][r][NO_SPIN] |= m;
                 }
             };
             if (x > 0)
@@ -159,7 +204,7 @@ Move* generate(Move* moves, const bool slow, const bool force, const Gen::Collis
         // Rotate
         if constexpr (p != O) {
             auto process = [&]<auto kicksRot>(Rotation r1) {
-                Bitboard current = toSearch[x][r];
+                W current = toSearch[x][r];
                 const auto& kicks = kicksRot[r];
     
                 const Coordinates src = Gen::canonical_offset<p>(r);
@@ -178,11 +223,14 @@ Move* generate(Move* moves, const bool slow, const bool force, const Gen::Collis
                     const int dy = kicks[i].y + ddy;
                     const int y1 = threshold + dy;
                     
-                    Bitboard m = ((current << y1) >> threshold) & ~cm(x1, r1);
+                    W m = ((current << y1) >> threshold) & ~cm(x1, r1);
                     current ^= (m << threshold) >> y1; 
+
+                    Stats::add(KICKS_TRIED);
+                    Stats::add(KICKS_ACCEPTED, m != 0);
     
                     if constexpr (checkSpin) {
-                        const Bitboard spins = m & spinMap[x1][0];
+                        const W spins = m & spinMap[x1][0];
 
                         spinSet[x1][r1][NO_SPIN] |= m ^ spins;
 
@@ -211,84 +259,648 @@ Move* generate(Move* moves, const bool slow, const bool force, const Gen::Collis
         searched[x][r] |= toSearch[x][r];
         toSearch[x][r] = 0;
         remaining ^= bb(index);
+        return moves;
     }
 
-    if constexpr (checkSpin)
-        for (int x = 0; x < COL_NB; ++x)
-            for (const Rotation r : allRotations) {
-                if (!moveSet[x][r])
-                    continue;
-
-                for (const auto s : {NO_SPIN, MINI, FULL}) {
-                    Bitboard current = moveSet[x][r] & spinSet[x][r][s];
-                    while (current) {
-                        *moves++ = Move(s == NO_SPIN ? T : TSPIN, r, x, ctz(current), s == FULL);
-                        current &= current - 1;
+    Move* finish(Move* moves) {
+        if constexpr (checkSpin)
+            for (int x = 0; x < COL_NB; ++x)
+                for (const Rotation r : allRotations) {
+                    if (!moveSet[x][r])
+                        continue;
+
+                    const W kept = moveSet[x][r] & static_cast<W>(filter.template mask<p>(x, r));
+                    for (const auto s : {NO_SPIN, MINI, FULL}) {
+                        if (F::SPINS_ONLY && s == NO_SPIN)
+                            continue;
+                        W current = kept & spinSet[x][r][s];
+                        if constexpr (gt == COUNT)
+                            count += static_cast<size_t>(popcount(current));
+                        else
+                            while (current) {
+                                *moves++ = Move(s == NO_SPIN ? T : TSPIN, r, x, ctz(current), s == FULL);
+                                current &= current - 1;
+                            }
                     }
                 }
+        return moves;
+    }
+};
+
+template<Piece p1, GenType gt, typename W, typename F>
+auto generate(Move* moves, const bool slow, const bool force, const F& filter, const Gen::CollisionMap<p1 == TSPIN ? T : p1, W>& cm, const Gen::BasicSpinMap<W>& spinMap = spinMapDummy<W>) {
+    Worklist<p1, gt, W, F> worklist(cm, filter, spinMap);
+    moves = worklist.start(moves, slow, force);
+    while (!worklist.done())
+        moves = worklist.step(moves);
+    moves = worklist.finish(moves);
+
+    if constexpr (gt == COUNT)
+        return worklist.counted();
+    else
+        return moves;
+}
+
+
+// Flood engine over lane groups: rather than popping one (x, rotation) from a
+// worklist, each step applies softdrop, shifts and every kick to all columns
+// of every rotation at once, until nothing new is reached. Moves come out
+// ordered by (x, rotation, y) instead of by discovery.
+template<Piece p1, GenType gt, typename F>
+auto flood(Move* moves, const bool slow, const bool force, const F& filter, const Gen::CollisionMap<p1 == TSPIN ? T : p1>& cm, [[maybe_unused]] const Gen::SpinMap& spinMap = spinMapDummy<Bitboard>) {
+    constexpr Piece p = p1 == TSPIN ? T : p1;
+    constexpr bool checkSpin = p1 == TSPIN;
+    constexpr int canonicalSize = Gen::canonical_size<p>();
+    constexpr int searchSize = p == O ? 1 : ROTATION_NB;
+    static_assert(is_ok(p));
+
+    using Gen::Lanes;
+    using Gen::LaneRow;
+    constexpr int groups = Gen::GROUP_NB;
+
+    size_t count = 0;
+    auto result = [&]{
+        if constexpr (gt == COUNT)
+            return count;
+        else
+            return moves;
+    };
+
+    auto emit = [&](const Piece piece, const Rotation r, const int x, Bitboard m, const bool fullspin = false) {
+        if (F::SPINS_ONLY && piece != TSPIN)
+            return;
+        if (m)
+            m &= filter.template mask<p>(x, r);
+        if constexpr (gt == COUNT)
+            count += static_cast<size_t>(popcount(m));
+        else
+            while (m) {
+                *moves++ = Move(piece, r, x, ctz(m), fullspin);
+                m &= m - 1;
             }
+    };
 
-    return moves;
+    alignas(32) Bitboard start[searchSize][Gen::COL_STRIDE] = {};
+
+    if (slow) {
+        const Bitboard spawn = [&]{
+            if (force) {
+                const Bitboard s = ~cm(Gen::SPAWN_COL, NORTH) & (~0ULL << Gen::SPAWN_ROW);
+                return s & -s;
+            }
+            return ~cm(Gen::SPAWN_COL, NORTH) & bb(Gen::SPAWN_ROW);
+        }();
+        if (!spawn)
+            return result();
+        start[NORTH][Gen::SPAWN_COL] = spawn;
+    } else {
+        int total = 0;
+        auto init = [&]<int x>{
+            auto process = [&]<Rotation r>{
+                if constexpr (!Gen::in_bounds<p, Gen::canonical_r<p>(r)>(x))
+                    return;
+                start[r][x] = bb_low(Gen::SPAWN_ROW) & ~bb_low(bitlen(cm(x, r)));
+                if constexpr (!checkSpin && r < canonicalSize)
+                    total += popcount(~cm(x, r) & ((cm(x, r) << 1) | 1)) - 1;
+            };
+
+            [&]<size_t... rs>(std::index_sequence<rs...>) {
+                (process.template operator()<static_cast<Rotation>(rs)>(), ...);
+            }(std::make_index_sequence<searchSize>());
+        };
+
+        [&]<size_t... xs>(std::index_sequence<xs...>) {
+            (init.template operator()<xs>(), ...);
+        }(std::make_index_sequence<COL_NB>());
+
+        // Every landing spot is on the surface, no search needed
+        if constexpr (!checkSpin)
+            if (!total) {
+                for (int x = 0; x < COL_NB; ++x)
+                    for (int r = 0; r < canonicalSize; ++r)
+                        if (start[r][x])
+                            emit(p, static_cast<Rotation>(r), x, bb(bitlen(cm(x, static_cast<Rotation>(r)))));
+                return result();
+            }
+    }
+
+    LaneRow free[searchSize];
+    LaneRow landing[searchSize];
+    LaneRow reach[searchSize];
+    LaneRow spins[checkSpin ? 1 + ROTATION_NB : 0];
+    LaneRow spinSet[ROTATION_NB][checkSpin ? SPIN_NB : 0] = {};
+
+    for (int r = 0; r < searchSize; ++r) {
+        LaneRow obstructed;
+        Gen::load_row(obstructed, cm.row(static_cast<Rotation>(r)));
+        Gen::load_row(reach[r], start[r]);
+        for (int g = 0; g < groups; ++g) {
+            free[r][g] = ~obstructed[g];
+            landing[r][g] = free[r][g] & ((obstructed[g] << 1) | 1);
+        }
+    }
+
+    if constexpr (checkSpin) {
+        alignas(32) Bitboard columns[1 + ROTATION_NB][Gen::COL_STRIDE] = {};
+        for (int x = 0; x < COL_NB; ++x)
+            for (int i = 0; i < 1 + ROTATION_NB; ++i)
+                columns[i][x] = spinMap[x][i];
+        for (int i = 0; i < 1 + ROTATION_NB; ++i)
+            Gen::load_row(spins[i], columns[i]);
+        for (int r = 0; r < ROTATION_NB; ++r)
+            for (int g = 0; g < groups; ++g)
+                spinSet[r][NO_SPIN][g] = reach[r][g];
+    }
+
+    auto for_groups = [](auto&& f) {
+        [&]<size_t... gs>(std::index_sequence<gs...>) {
+            (f.template operator()<static_cast<int>(gs)>(), ...);
+        }(std::make_index_sequence<groups>());
+    };
+
+    // Vertical shift in place, vectors never go through a call by value
+    auto shift_rows = []<int dy>(Lanes& v) {
+        if constexpr (dy > 0)
+            v <<= dy;
+        else if constexpr (dy < 0)
+            v >>= -dy;
+    };
+
+    bool changed = true;
+    while (changed) {
+        LaneRow before[searchSize];
+        __builtin_memcpy(&before, &reach, sizeof(reach));
+
+        for (int r = 0; r < searchSize; ++r) {
+            // Softdrops, as an occluded fill down through free cells
+            for (int g = 0; g < groups; ++g) {
+                Lanes pro = free[r][g];
+                Lanes gen = (reach[r][g] >> 1) & pro;
+                gen |= pro & (gen >> 1);
+                pro &= pro >> 1;
+                gen |= pro & (gen >> 2);
+                pro &= pro >> 2;
+                gen |= pro & (gen >> 4);
+                pro &= pro >> 4;
+                gen |= pro & (gen >> 8);
+                pro &= pro >> 8;
+                gen |= pro & (gen >> 16);
+                pro &= pro >> 16;
+                gen |= pro & (gen >> 32);
+                reach[r][g] |= gen;
+                if constexpr (checkSpin)
+                    spinSet[r][NO_SPIN][g] |= gen;
+            }
+
+            // Shifts
+            const LaneRow& current = reach[r];
+            LaneRow shifted;
+            for_groups([&]<int g>{
+                Lanes left, right;
+                Gen::shift_row<1, g>(left, current);
+                Gen::shift_row<-1, g>(right, current);
+                shifted[g] = (left | right) & free[r][g];
+            });
+            for (int g = 0; g < groups; ++g) {
+                reach[r][g] |= shifted[g];
+                if constexpr (checkSpin)
+                    spinSet[r][NO_SPIN][g] |= shifted[g];
+            }
+        }
+
+        // Rotate
+        if constexpr (p != O) {
+            auto process = [&]<Rotation r, Rotation r1, auto kicksRot>{
+                constexpr auto kicks = kicksRot[r];
+                constexpr Coordinates src = Gen::canonical_offset<p>(r);
+                constexpr Coordinates tgt = Gen::canonical_offset<p>(r1);
+
+                LaneRow current;
+                __builtin_memcpy(&current, &reach[r], sizeof(current));
+
+                [&]<size_t... is>(std::index_sequence<is...>) {
+                    auto kick = [&]<size_t i>{
+                        constexpr int dx = kicks[i].x + src.x - tgt.x;
+                        constexpr int dy = kicks[i].y + src.y - tgt.y;
+                        // Rows 61 and above are never entered by a rotation
+                        constexpr Bitboard ceiling = ~0ULL >> 3;
+
+                        LaneRow m;
+                        for_groups([&]<int g>{
+                            Gen::shift_row<dx, g>(m[g], current);
+                            shift_rows.template operator()<dy>(m[g]);
+                            m[g] &= free[r1][g] & ceiling;
+                        });
+                        for_groups([&]<int g>{
+                            Lanes back;
+                            Gen::shift_row<-dx, g>(back, m);
+                            shift_rows.template operator()<-dy>(back);
+                            current[g] ^= back;
+                        });
+
+                        for (int g = 0; g < groups; ++g) {
+                            if constexpr (checkSpin) {
+                                const Lanes hits = m[g] & spins[0][g];
+                                spinSet[r1][NO_SPIN][g] |= m[g] ^ hits;
+                                if constexpr (i >= 4)
+                                    spinSet[r1][FULL][g] |= hits;
+                                else {
+                                    spinSet[r1][MINI][g] |= hits & ~spins[1 + r1][g];
+                                    spinSet[r1][FULL][g] |= hits & spins[1 + r1][g];
+                                }
+                            }
+                            reach[r1][g] |= m[g];
+                        }
+                    };
+                    (kick.template operator()<is>(), ...);
+                }(std::make_index_sequence<kicks.size()>());
+            };
+
+            auto rotations = [&]<Rotation r>{
+                constexpr Rotation cw = Gen::rotate<Gen::Direction::CW>(r);
+                constexpr Rotation ccw = Gen::rotate<Gen::Direction::CCW>(r);
+                constexpr Rotation flip = Gen::rotate<Gen::Direction::FLIP>(r);
+                process.template operator()<r, cw, Gen::kicks[p == I][Gen::Direction::CW]>();
+                process.template operator()<r, ccw, Gen::kicks[p == I][Gen::Direction::CCW]>();
+                process.template operator()<r, flip, Gen::kicks180[p == I]>();
+            };
+
+            [&]<size_t... rs>(std::index_sequence<rs...>) {
+                (rotations.template operator()<static_cast<Rotation>(rs)>(), ...);
+            }(std::make_index_sequence<ROTATION_NB>());
+        }
+
+        Lanes diff{};
+        for (int r = 0; r < searchSize; ++r)
+            for (int g = 0; g < groups; ++g)
+                diff |= reach[r][g] ^ before[r][g];
+        changed = false;
+        for (int i = 0; i < Gen::LANE_NB; ++i)
+            changed |= diff[i] != 0;
+    }
+
+    alignas(32) Bitboard moveSet[searchSize][Gen::COL_STRIDE];
+    for (int r = 0; r < searchSize; ++r) {
+        LaneRow m;
+        for (int g = 0; g < groups; ++g)
+            m[g] = reach[r][g] & landing[r][g];
+        __builtin_memcpy(&moveSet[r], &m, sizeof(m));
+    }
+
+    if constexpr (checkSpin) {
+        alignas(32) Bitboard spinMoves[ROTATION_NB][SPIN_NB][Gen::COL_STRIDE];
+        for (int r = 0; r < ROTATION_NB; ++r)
+            for (int s = 0; s < SPIN_NB; ++s) {
+                LaneRow m;
+                for (int g = 0; g < groups; ++g)
+                    m[g] = reach[r][g] & landing[r][g] & spinSet[r][s][g];
+                __builtin_memcpy(&spinMoves[r][s], &m, sizeof(m));
+            }
+
+        for (int x = 0; x < COL_NB; ++x)
+            for (const Rotation r : allRotations)
+                for (const auto s : {NO_SPIN, MINI, FULL})
+                    emit(s == NO_SPIN ? T : TSPIN, r, x, spinMoves[r][s][x], s == FULL);
+    } else
+        for (int x = 0; x < COL_NB; ++x)
+            for (int r1 = 0; r1 < canonicalSize; ++r1) {
+                Bitboard m = 0;
+                for (int r = 0; r < searchSize; ++r)
+                    if (Gen::canonical_r<p>(static_cast<Rotation>(r)) == r1)
+                        m |= moveSet[r][x];
+                emit(p, static_cast<Rotation>(r1), x, m);
+            }
+
+    return result();
 }
 
-Move* generate(const Board& b, Move* moves, const Piece p, const bool force) {
-    const bool slow = [&]{
-        Bitboard m = b[0];
-        for (int i = 1; i < COL_NB; ++i)
-            m |= b[i];
-        return bitlen(m) > Gen::SPAWN_ROW - 3;
-    }();
+template<Piece p1, GenType gt, Engine en, typename... Args>
+auto search(Args&&... args) {
+    if constexpr (en == FLOOD)
+        return flood<p1, gt>(std::forward<Args>(args)...);
+    else
+        return generate<p1, gt>(std::forward<Args>(args)...);
+}
 
+// collisionMap<p>() and spinMap() supply the board preprocessing, built on the
+// spot or taken from maps shared with other pieces or kept from a parent board
+template<GenType gt, Engine en = DEFAULT_ENGINE, typename CM, typename SM, typename F = Filter::All>
+auto generate_piece(CM&& collisionMap, SM&& spinMap, const bool slow, Move* moves, const Piece p, const bool force, const F& filter = F{}) {
+    auto none = [moves]{
+        if constexpr (gt == COUNT)
+            return size_t(0);
+        else
+            return moves;
+    };
+
+    // Only a T can spin, and only once the board has a spin corner
+    if constexpr (F::SPINS_ONLY)
+        if (p != T)
+            return none();
+    if (filter.empty())
+        return none();
+
+    Stats::add(SEARCHES);
+    Stats::add(SLOW_SEARCHES, slow);
     switch(p) {
-        case I: return generate<I>(moves, slow, force, Gen::CollisionMap<I>(b));
-        case O: return generate<O>(moves, slow, force, Gen::CollisionMap<O>(b));
+        case I: return search<I, gt, en>(moves, slow, force, filter, collisionMap.template operator()<I>());
+        case O: return search<O, gt, en>(moves, slow, force, filter, collisionMap.template operator()<O>());
         case T:
             {
-                const Gen::CollisionMap<T> cm(b);
-                bool checkSpin = false;
-                Bitboard spinMap[COL_NB][1 + ROTATION_NB] = {};
-                auto init = [&]<int x>{
-                    const Bitboard corners[] = {
-                        x > 0 ? b[x - 1] >> 1 : ~0ULL,
-                        x < 9 ? b[x + 1] >> 1 : ~0ULL,
-                        x < 9 ? (b[x + 1] << 1 | 1) : ~0ULL,
-                        x > 0 ? (b[x - 1] << 1 | 1) : ~0ULL
-                    };
+                const auto& cm = collisionMap.template operator()<T>();
+                const auto& sm = spinMap();
+                if (sm.any(cm)) {
+                    Stats::add(SPIN_SEARCHES);
+                    return search<TSPIN, gt, en>(moves, slow, force, filter, cm, sm);
+                }
+                if constexpr (F::SPINS_ONLY)
+                    return none();
+                return search<T, gt, en>(moves, slow, force, filter, cm);
+            }
+        case L: return search<L, gt, en>(moves, slow, force, filter, collisionMap.template operator()<L>());
+        case J: return search<J, gt, en>(moves, slow, force, filter, collisionMap.template operator()<J>());
+        case S: return search<S, gt, en>(moves, slow, force, filter, collisionMap.template operator()<S>());
+        case Z: return search<Z, gt, en>(moves, slow, force, filter, collisionMap.template operator()<Z>());
+        default: __builtin_unreachable();
+    }
+}
 
-                    const Bitboard spins = (
-                        (corners[0] & corners[1] & (corners[2] | corners[3])) |
-                        (corners[2] & corners[3] & (corners[0] | corners[1]))
-                    );
-
-                    spinMap[x][0] = spins;
-                    if (spins) {
-                        auto process = [&]<Rotation r>{
-                            if (Gen::in_bounds<T, r>(x)) {
-                                spinMap[x][1 + r] = spins & corners[r] & corners[Gen::rotate<Gen::Direction::CW>(r)];
-                                checkSpin |= spins & ~cm(x, r) & ((cm(x, r) << 1) | 1);
-                            }
-                        };
+template<typename W>
+static auto build_maps(const BasicBoard<W>& b) {
+    return [&b]<Piece p>{ return Gen::CollisionMap<p, W>(b); };
+}
 
-                        [&]<size_t... rs>(std::index_sequence<rs...>) {
-                            (process.template operator()<static_cast<Rotation>(rs)>(), ...);
-                        }(std::make_index_sequence<ROTATION_NB>());
-                    }
-                };
+template<typename W>
+static auto build_spin_map(const BasicBoard<W>& b) {
+    return [&b]{
+        Stats::add(SPIN_MAPS);
+        return Gen::BasicSpinMap<W>(b);
+    };
+}
 
-                [&]<size_t... xs>(std::index_sequence<xs...>) {
-                    (init.template operator()<xs>(), ...);
-                }(std::make_index_sequence<COL_NB>());
+static auto use_spin_map(const Gen::SpinMap& spinMap) {
+    return [&spinMap]() -> const Gen::SpinMap& { return spinMap; };
+}
+
+DISPATCH Move* generate(const Board& b, Move* moves, const Piece p, const bool force) {
+    return generate_piece<MOVES>(build_maps(b), build_spin_map(b), Gen::BoardInfo(b).slow, moves, p, force);
+}
+
+DISPATCH Move* generate(const Board& b, Move* moves, const Piece p, const bool force, const Engine engine) {
+    const bool slow = Gen::BoardInfo(b).slow;
+    return engine == FLOOD ? generate_piece<MOVES, FLOOD>(build_maps(b), build_spin_map(b), slow, moves, p, force)
+                           : generate_piece<MOVES, WORKLIST>(build_maps(b), build_spin_map(b), slow, moves, p, force);
+}
+
+DISPATCH size_t count_moves(const Board& b, const Piece p, const bool force) {
+    return generate_piece<COUNT>(build_maps(b), build_spin_map(b), Gen::BoardInfo(b).slow, nullptr, p, force);
+}
+
+// Only stacks below the spawn area are searched on 32-bit columns: nothing rises
+// more than a few rows above the spawn row then, while a search from a forced
+// spawn can climb along the stack past the top of the word.
+DISPATCH Move* generate(const NarrowBoard& b, Move* moves, const Piece p, const bool force) {
+    if (Gen::BoardInfo(b).slow) {
+        Board wide;
+        wide.set(b);
+        return generate(wide, moves, p, force);
+    }
+    return generate_piece<MOVES, WORKLIST>(build_maps(b), build_spin_map(b), false, moves, p, force);
+}
+
+DISPATCH size_t count_moves(const NarrowBoard& b, const Piece p, const bool force) {
+    if (Gen::BoardInfo(b).slow) {
+        Board wide;
+        wide.set(b);
+        return count_moves(wide, p, force);
+    }
+    return generate_piece<COUNT, WORKLIST>(build_maps(b), build_spin_map(b), false, nullptr, p, force);
+}
 
-                if (checkSpin)
-                    return generate<TSPIN>(moves, slow, force, cm, spinMap);
-                return generate<T>(moves, slow, force, cm);
+DISPATCH Move* generate_all(const Board& b, Move* moves, const unsigned pieces, const bool force, Move* (&ranges)[PIECE_NB + 1]) {
+    const bool slow = Gen::BoardInfo(b).slow;
+    const Gen::ColumnLanes<Bitboard> cols(b);
+    const Gen::SpinMap spinMap = (pieces & (1U << T)) ? Gen::SpinMap(b) : Gen::SpinMap();
+    Stats::add(SPIN_MAPS, (pieces >> T) & 1);
+
+    for (const Piece p : allPieces) {
+        ranges[p] = moves;
+        if (pieces & (1U << p))
+            moves = generate_piece<MOVES>([&b, &cols]<Piece q>{ return Gen::CollisionMap<q>(b, cols); },
+                                          use_spin_map(spinMap), slow, moves, p, force);
+    }
+    ranges[PIECE_NB] = moves;
+    return moves;
+}
+
+DISPATCH Move* generate_all(const Board& b, Move* moves, const unsigned pieces, const bool force, Move* (&ranges)[PIECE_NB + 1],
+                            MoveOutcome* outcomes) {
+    Move* const last = generate_all(b, moves, pieces, force, ranges);
+    move_outcomes(b, moves, last, outcomes);
+    return last;
+}
+
+DISPATCH Move* generate(const Board& b, Move* moves, const Piece p, const bool force, const Filter::LineClears& filter) {
+    return generate_piece<MOVES>(build_maps(b), build_spin_map(b), Gen::BoardInfo(b).slow, moves, p, force, filter);
+}
+
+DISPATCH Move* generate(const Board& b, Move* moves, const Piece p, const bool force, const Filter::Spins& filter) {
+    return generate_piece<MOVES>(build_maps(b), build_spin_map(b), Gen::BoardInfo(b).slow, moves, p, force, filter);
+}
+
+DISPATCH Move* generate(const Board& b, Move* moves, const Piece p, const bool force, const Filter::Below& filter) {
+    return generate_piece<MOVES>(build_maps(b), build_spin_map(b), Gen::BoardInfo(b).slow, moves, p, force, filter);
+}
+
+DISPATCH size_t count_moves(const Board& b, const Piece p, const bool force, const Filter::LineClears& filter) {
+    return generate_piece<COUNT>(build_maps(b), build_spin_map(b), Gen::BoardInfo(b).slow, nullptr, p, force, filter);
+}
+
+DISPATCH size_t count_moves(const Board& b, const Piece p, const bool force, const Filter::Spins& filter) {
+    return generate_piece<COUNT>(build_maps(b), build_spin_map(b), Gen::BoardInfo(b).slow, nullptr, p, force, filter);
+}
+
+DISPATCH size_t count_moves(const Board& b, const Piece p, const bool force, const Filter::Below& filter) {
+    return generate_piece<COUNT>(build_maps(b), build_spin_map(b), Gen::BoardInfo(b).slow, nullptr, p, force, filter);
+}
+
+void move_outcomes(const Board& b, const Move* first, const Move* last, MoveOutcome* outcomes) {
+    // Bit-sliced clear count and perfect clears over the pivot rows
+    struct Masks {
+        Bitboard count[3];
+        Bitboard pc;
+    };
+
+    const Filter::LineClears rows(b);
+    Bitboard occupied = 0;
+    for (int x = 0; x < COL_NB; ++x)
+        occupied |= b[x];
+
+    Masks masks[PIECE_NB][COL_NB][ROTATION_NB];
+    uint64_t built[PIECE_NB] = {};
+
+    for (const Move* m = first; m != last; ++m) {
+        const Piece p = m->piece();
+        const int x = m->x();
+        const Rotation r = m->rotation();
+        Masks& mk = masks[p][x][r];
+
+        if (!(built[p] & bb(x * ROTATION_NB + r))) {
+            built[p] |= bb(x * ROTATION_NB + r);
+            const RowSpans& rs = ROW_SPANS[p][r];
+            Bitboard ones = 0, twos = 0, fours = 0, all = ~Bitboard(0);
+            for (int i = 0; i < rs.count; ++i) {
+                const Bitboard c = rows.clears(rs.rows[i], x);
+                const Bitboard carry = ones & c;
+                fours |= twos & carry;
+                twos ^= carry;
+                ones ^= c;
+                all &= c;
+            }
+
+            // Every row of the piece clears and the board has nothing outside them
+            mk.pc = 0;
+            if (popcount(occupied) <= rs.count)
+                for (Bitboard ys = all; ys; ys &= ys - 1) {
+                    Bitboard covered = 0;
+                    for (int i = 0; i < rs.count; ++i)
+                        covered |= bb(ctz(ys) + rs.rows[i].y);
+                    if (!(occupied & ~covered))
+                        mk.pc |= bb(ctz(ys));
+                }
+            mk.count[0] = ones;
+            mk.count[1] = twos;
+            mk.count[2] = fours;
+        }
+
+        const int y = m->y();
+        *outcomes++ = MoveOutcome{static_cast<int>((mk.count[0] >> y & 1) | (mk.count[1] >> y & 1) << 1 | (mk.count[2] >> y & 1) << 2),
+                                  m->spin(), static_cast<bool>(mk.pc >> y & 1)};
+    }
+}
+
+DISPATCH Move* generate(const Board& b, Move* moves, const Piece p, const bool force, MoveOutcome* outcomes) {
+    Move* const last = generate(b, moves, p, force);
+    move_outcomes(b, moves, last, outcomes);
+    return last;
+}
+
+constexpr Filter::All unfiltered;
+
+// Worklist of one piece with the collision map it searches, built in place by
+// MoveStream::reset()
+template<Piece p1>
+class PieceStream {
+private:
+    const Gen::CollisionMap<p1 == TSPIN ? T : p1> cm;
+    Worklist<p1, MOVES, Bitboard, Filter::All> worklist;
+    const bool slow;
+    const bool force;
+    bool started = false;
+    bool finished = false;
+
+public:
+    // source is the board, or the map when reset() already built it
+    template<typename Source>
+    PieceStream(const Source& source, const Gen::SpinMap& spinMap, const bool s, const bool f) :
+        cm(source), worklist(cm, unfiltered, spinMap), slow(s), force(f) {}
+
+    Move* next(Move* moves) {
+        Move* const first = moves;
+        if (!started) {
+            started = true;
+            if ((moves = worklist.start(moves, slow, force)) != first)
+                return moves;
+        }
+        while (!worklist.done())
+            if ((moves = worklist.step(moves)) != first)
+                return moves;
+        if (!finished) {
+            finished = true;
+            moves = worklist.finish(moves);
+        }
+        return moves;
+    }
+};
+
+struct MoveStream::Impl {
+    Gen::SpinMap spinMap; // Of the last T reset
+    std::variant<std::monostate, PieceStream<I>, PieceStream<O>, PieceStream<T>, PieceStream<TSPIN>,
+                 PieceStream<L>, PieceStream<J>, PieceStream<S>, PieceStream<Z>> search;
+};
+
+MoveStream::MoveStream() : impl(std::make_unique<Impl>()) {}
+
+MoveStream::~MoveStream() = default;
+
+void MoveStream::reset(const Board& b, const Piece p, const bool force) {
+    assert(is_ok(p));
+    const bool slow = Gen::BoardInfo(b).slow;
+    Stats::add(SEARCHES);
+    Stats::add(SLOW_SEARCHES, slow);
+
+    auto& search = impl->search;
+    const Gen::SpinMap& spinMap = impl->spinMap;
+    switch (p) {
+        case I: search.emplace<PieceStream<I>>(b, spinMap, slow, force); break;
+        case O: search.emplace<PieceStream<O>>(b, spinMap, slow, force); break;
+        case T:
+            {
+                const Gen::CollisionMap<T> cm(b);
+                Stats::add(SPIN_MAPS);
+                impl->spinMap = Gen::SpinMap(b);
+                if (spinMap.any(cm)) {
+                    Stats::add(SPIN_SEARCHES);
+                    search.emplace<PieceStream<TSPIN>>(cm, spinMap, slow, force);
+                }
+                else
+                    search.emplace<PieceStream<T>>(cm, spinMap, slow, force);
+                break;
             }
-        case L: return generate<L>(moves, slow, force, Gen::CollisionMap<L>(b));
-        case J: return generate<J>(moves, slow, force, Gen::CollisionMap<J>(b));
-        case S: return generate<S>(moves, slow, force, Gen::CollisionMap<S>(b));
-        case Z: return generate<Z>(moves, slow, force, Gen::CollisionMap<Z>(b));
+        case L: search.emplace<PieceStream<L>>(b, spinMap, slow, force); break;
+        case J: search.emplace<PieceStream<J>>(b, spinMap, slow, force); break;
+        case S: search.emplace<PieceStream<S>>(b, spinMap, slow, force); break;
+        case Z: search.emplace<PieceStream<Z>>(b, spinMap, slow, force); break;
         default: __builtin_unreachable();
     }
 }
 
+Move* MoveStream::next(Move* moves) {
+    return std::visit([moves](auto& search) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(search)>, std::monostate>)
+            return moves;
+        else
+            return search.next(moves);
+    }, impl->search);
+}
+
+Move* unique_moves(const State& state, Move* first, Move* last, const MovePreference better, size_t& pruned) {
+    // Open addressing on the child keys at no more than half load
+    constexpr size_t slotCount = 4 * MAX_MOVES;
+    assert(last - first < 2 * MAX_MOVES);
+    Key keys[slotCount];
+    uint16_t kept[slotCount] = {}; // 1 + index of the kept move, 0 for an empty slot
+
+    Move* out = first;
+    for (const Move* m = first; m != last; ++m) {
+        State child = state;
+        child.do_move(*m);
+
+        size_t i = child.key & (slotCount - 1);
+        while (kept[i] && keys[i] != child.key)
+            i = (i + 1) & (slotCount - 1);
+
+        if (!kept[i]) {
+            keys[i] = child.key;
+            kept[i] = static_cast<uint16_t>(out - first + 1);
+            *out++ = *m;
+        }
+        else if (better(*m, first[kept[i] - 1]))
+            first[kept[i] - 1] = *m;
+    }
+
+    pruned = static_cast<size_t>(last - out);
+    return out;
+}
+
 } // namespace Cobra
\ No newline at end of file
@@ -5,18 +5,245 @@
 #include "header.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstddef>
+#include <memory>
 
 namespace Cobra {
 
 constexpr int MAX_MOVES = 256;
+constexpr int MAX_PLY = 64;
+
+enum GenType {
+    MOVES, COUNT
+};
+
+// Search engines behind generate(): the (x, rotation) worklist, or the flood
+// fill over lane groups, chosen per build with flood=yes
+enum Engine {
+    WORKLIST, FLOOD
+};
+
+#ifdef USE_FLOOD
+constexpr Engine DEFAULT_ENGINE = FLOOD;
+#else
+constexpr Engine DEFAULT_ENGINE = WORKLIST;
+#endif
 
 Move* generate(const Board& b, Move* moves, Piece p, bool force);
 
-class MoveList {
+// Explicit engine, for validating one against the other. Move order differs between engines.
+Move* generate(const Board& b, Move* moves, Piece p, bool force, Engine engine);
+
+// Number of moves generate() would emit, without writing any of them
+size_t count_moves(const Board& b, Piece p, bool force = false);
+
+// Same as generate() and count_moves() on 32-bit columns. A stack reaching into
+// the spawn area is searched on a full-height copy instead.
+Move* generate(const NarrowBoard& b, Move* moves, Piece p, bool force);
+size_t count_moves(const NarrowBoard& b, Piece p, bool force = false);
+
+// A row of a piece: its offset from the pivot and the columns the piece fills in it
+struct RowSpan {
+    int y, lo, hi;
+};
+
+// Distinct rows of a piece in one rotation. The cells of a tetromino in one row
+// are contiguous, so a span describes them exactly.
+struct RowSpans {
+    RowSpan rows[4];
+    int count;
+};
+
+constexpr auto ROW_SPANS = []{
+    std::array<std::array<RowSpans, ROTATION_NB>, PIECE_NB> table{};
+    for (int p = 0; p < PIECE_NB; ++p)
+        for (int r = 0; r < ROTATION_NB; ++r) {
+            const PieceCoordinates pc = piece_table(static_cast<Piece>(p), static_cast<Rotation>(r));
+            RowSpans& rs = table[p][r];
+            for (size_t i = 0; i < 4; ++i) {
+                int j = 0;
+                while (j < rs.count && rs.rows[j].y != pc[i].y)
+                    ++j;
+                if (j == rs.count)
+                    rs.rows[rs.count++] = {pc[i].y, pc[i].x, pc[i].x};
+                rs.rows[j].lo = std::min<int>(rs.rows[j].lo, pc[i].x);
+                rs.rows[j].hi = std::max<int>(rs.rows[j].hi, pc[i].x);
+            }
+        }
+    return table;
+}();
+
+// Compile-time policies for the filtered generate() and count_moves(). mask<p>(x, r)
+// holds the rows y whose Move(p, r, x, y) is kept, r being the rotation the move is
+// emitted with, and SPINS_ONLY drops every placement without a spin. They are
+// applied to the move bitboards of the search before any Move is written, and
+// empty() skips the search when the board rules out every move.
+namespace Filter {
+
+struct All {
+    static constexpr bool SPINS_ONLY = false;
+
+    constexpr bool empty() const { return false; }
+
+    template<Piece p>
+    constexpr Bitboard mask(int, Rotation) const { return ~Bitboard(0); }
+};
+
+// Placements completing at least one row
+class LineClears {
+private:
+    Bitboard prefix[COL_NB + 1]; // Rows filled on the columns [0, x)
+    Bitboard suffix[COL_NB + 1]; // Rows filled on the columns [x, COL_NB)
+    Bitboard open = 0;           // Rows a piece could fill
+
+public:
+    static constexpr bool SPINS_ONLY = false;
+
+    explicit LineClears(const Board& b) {
+        prefix[0] = suffix[COL_NB] = ~Bitboard(0);
+        for (int x = 0; x < COL_NB; ++x) {
+            prefix[x + 1] = prefix[x] & b[x];
+            suffix[COL_NB - 1 - x] = suffix[COL_NB - x] & b[COL_NB - 1 - x];
+        }
+        for (int x = 0; x < COL_NB; ++x)
+            open |= prefix[x] & suffix[std::min(x + 4, COL_NB)];
+    }
+
+    // No row has its empty cells within 4 columns, the search can be skipped
+    bool empty() const { return !open; }
+
+    // Rows y where the piece row s of a piece at (x, y) clears: the board fills it
+    // outside the piece's cells
+    Bitboard clears(const RowSpan& s, const int x) const {
+        assert(is_ok_x(x + s.lo) && is_ok_x(x + s.hi));
+        const Bitboard rows = prefix[x + s.lo] & suffix[x + s.hi + 1];
+        return s.y >= 0 ? rows >> s.y : rows << -s.y;
+    }
+
+    template<Piece p>
+    Bitboard mask(const int x, const Rotation r) const {
+        const RowSpans& rs = ROW_SPANS[p][r];
+        Bitboard m = 0;
+        for (int i = 0; i < rs.count; ++i)
+            m |= clears(rs.rows[i], x);
+        return m;
+    }
+};
+
+// T placements with a spin, nothing for the other pieces
+struct Spins {
+    static constexpr bool SPINS_ONLY = true;
+
+    constexpr bool empty() const { return false; }
+
+    template<Piece p>
+    constexpr Bitboard mask(int, Rotation) const { return ~Bitboard(0); }
+};
+
+// Placements with every cell below row height
+class Below {
+private:
+    int height;
+
+public:
+    static constexpr bool SPINS_ONLY = false;
+
+    explicit constexpr Below(const int h) : height(h) {}
+
+    constexpr bool empty() const { return height <= 0; }
+
+    template<Piece p>
+    constexpr Bitboard mask(int, const Rotation r) const {
+        const PieceCoordinates pc = piece_table(p, r);
+        const int top = std::max({pc[0].y, pc[1].y, pc[2].y, pc[3].y});
+        const int rows = height - top;
+        return rows <= 0 ? 0 : rows >= ROW_NB ? ~Bitboard(0) : bb_low(rows);
+    }
+};
+
+} // namespace Filter
+
+// generate() and count_moves() keeping only the moves the filter lets through
+Move* generate(const Board& b, Move* moves, Piece p, bool force, const Filter::LineClears& filter);
+Move* generate(const Board& b, Move* moves, Piece p, bool force, const Filter::Spins& filter);
+Move* generate(const Board& b, Move* moves, Piece p, bool force, const Filter::Below& filter);
+size_t count_moves(const Board& b, Piece p, bool force, const Filter::LineClears& filter);
+size_t count_moves(const Board& b, Piece p, bool force, const Filter::Spins& filter);
+size_t count_moves(const Board& b, Piece p, bool force, const Filter::Below& filter);
+
+// Lines cleared, spin and perfect clear of a move, as do_move would report them.
+// The spin is the move's own, do_move only reports it along with a clear.
+struct MoveOutcome {
+    int clear;
+    SpinType spin;
+    bool pc;
+};
+
+// Outcomes of [first, last) on b, one per move. The clear counts and perfect
+// clears come from row masks built once per (piece, x, rotation), so no State is
+// touched and moves sharing a column and rotation cost a few bit tests each.
+void move_outcomes(const Board& b, const Move* first, const Move* last, MoveOutcome* outcomes);
+
+// Same as generate(), writing the outcome of moves[i] to outcomes[i]
+Move* generate(const Board& b, Move* moves, Piece p, bool force, MoveOutcome* outcomes);
+
+// generate() on the worklist engine, resumed a batch at a time so a consumer can
+// stop once it has the moves it needs. The first batch holds the surface
+// placements, each later one the harddrops of one worklist pop. T moves on a
+// board with spin corners come in one last batch, a spin is only settled once
+// nothing is left to search. The batches are generate(b, moves, p, force, WORKLIST) in order.
+class MoveStream {
 private:
-    Move moves[MAX_MOVES];
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+
+public:
+    MoveStream();
+    ~MoveStream();
+
+    // Builds the maps of p on b, the search itself waits for next()
+    void reset(const Board& b, Piece p, bool force = false);
+
+    // Writes the next batch to moves, which must have room for MAX_MOVES, and
+    // returns its end. Returns moves once every move is out.
+    Move* next(Move* moves);
+};
+
+constexpr unsigned ALL_PIECES = (1U << PIECE_NB) - 1;
+
+// Whether a should stand for the moves reaching the same State rather than b
+using MovePreference = bool (*)(const Move& a, const Move& b);
+
+constexpr bool prefer_spin(const Move& a, const Move& b) {
+    return a.spin() > b.spin();
+}
+
+// Compacts [first, last) to one move per distinct state.do_move(move) result,
+// keeping the preferred one of each group. Results are compared by key before
+// any hold swap, so moves of the current and the hold piece filling the same
+// cells collapse too. [first, last) holds fewer than 2 * MAX_MOVES moves, those
+// of a piece and its hold. Returns the new end, the dropped moves go to pruned.
+Move* unique_moves(const State& state, Move* first, Move* last, MovePreference better, size_t& pruned);
+
+// Generates every piece in the mask (bit p for piece p) on one board, sharing the
+// board preprocessing: column union and height, the column lanes every collision
+// map is built from and T's corner masks. Piece p's moves are [ranges[p], ranges[p + 1]).
+Move* generate_all(const Board& b, Move* moves, unsigned pieces, bool force, Move* (&ranges)[PIECE_NB + 1]);
+
+// Same as above, writing the outcome of moves[i] to outcomes[i]. The line-fill
+// masks of b and the row masks of each (piece, x, rotation) are built once for
+// every piece in the mask.
+Move* generate_all(const Board& b, Move* moves, unsigned pieces, bool force, Move* (&ranges)[PIECE_NB + 1],
+                   MoveOutcome* outcomes);
+
+// Moves of one board, with room for N of them
+template<size_t N>
+class BasicMoveList {
+private:
+    Move moves[N];
+    size_t prunedCount = 0;
     const Move* const last;
 
     bool no_duplicates() const {
@@ -44,30 +271,126 @@ private:
     }
 
 public:
-    MoveList(const Board& b, Piece p) : last(generate(b, moves, p, false)) {
+    BasicMoveList(const Board& b, Piece p) : last(generate(b, moves, p, false)) {
+        static_assert(N >= MAX_MOVES);
         assert(size() < MAX_MOVES);
         assert(no_duplicates());
         assert(all_valid(b));
     }
 
-    MoveList(const Board& b, Piece p, Piece hold, bool force = false) :
+    BasicMoveList(const Board& b, Piece p, Piece hold, bool force = false) :
         last([&]{
             Move* l = generate(b, moves, p, force);
             return (l != moves && p != hold) ? generate(b, l, hold, force) : l;
         }()) {
-        assert(size() < MAX_MOVES);
+        static_assert(N >= 2 * MAX_MOVES);
+        assert(size() < 2 * MAX_MOVES);
         assert(no_duplicates());
         assert(all_valid(b));
     }
 
+    // Moves of p leading to distinct States, see unique_moves()
+    BasicMoveList(const State& state, Piece p, MovePreference better, bool force = false) :
+        last(unique_moves(state, moves, generate(state.board, moves, p, force), better, prunedCount)) {
+        static_assert(N >= MAX_MOVES);
+        assert(size() < MAX_MOVES);
+        assert(all_valid(state.board));
+    }
+
+    // Same for p and hold (just p if they are equal). Unlike the Board version,
+    // hold is generated when p has no move.
+    BasicMoveList(const State& state, Piece p, Piece hold, MovePreference better, bool force = false) :
+        last([&]{
+            Move* l = generate(state.board, moves, p, force);
+            if (p != hold)
+                l = generate(state.board, l, hold, force);
+            return unique_moves(state, moves, l, better, prunedCount);
+        }()) {
+        static_assert(N >= 2 * MAX_MOVES);
+        assert(size() < 2 * MAX_MOVES);
+        assert(all_valid(state.board));
+    }
+
     size_t size() const { return static_cast<size_t>(last - moves); }
     bool empty() const { return last == moves; }
     bool contains(const Move& m) const { return std::any_of(begin(), end(), [m](const Move& move) { return move == m; }); }
 
+    // Moves dropped as leading to the same State as a kept one
+    size_t pruned() const { return prunedCount; }
+
     const Move* begin() const { return moves; }
     const Move* end() const { return last; }
 };
 
+using MoveList = BasicMoveList<MAX_MOVES>;
+using HoldMoveList = BasicMoveList<2 * MAX_MOVES>; // Room for a piece and its hold
+
+// View over moves owned by a MoveStack or PieceMoveLists
+class MoveSpan {
+private:
+    Move* first;
+    Move* last;
+
+public:
+    constexpr MoveSpan(Move* f, Move* l) : first(f), last(l) {}
+
+    size_t size() const { return static_cast<size_t>(last - first); }
+    bool empty() const { return last == first; }
+    bool contains(const Move& m) const { return std::any_of(begin(), end(), [m](const Move& move) { return move == m; }); }
+
+    Move* begin() const { return first; }
+    Move* end() const { return last; }
+};
+
+// Move lists of several pieces on the same board, e.g. the rest of a bag
+class PieceMoveLists {
+private:
+    Move moves[PIECE_NB * MAX_MOVES];
+    Move* ranges[PIECE_NB + 1];
+
+public:
+    explicit PieceMoveLists(const Board& b, unsigned pieces = ALL_PIECES, bool force = false) {
+        generate_all(b, moves, pieces, force, ranges);
+    }
+
+    MoveSpan operator[](const Piece p) const {
+        assert(is_ok(p));
+        return MoveSpan(ranges[p], ranges[p + 1]);
+    }
+
+    size_t size() const { return static_cast<size_t>(ranges[PIECE_NB] - moves); }
+};
+
+// Contiguous per-thread arena for recursive search: each ply's moves are
+// generated straight after its parent's, so the working set stays a single
+// stack instead of a MoveList per frame. Spans must be popped in LIFO order.
+class MoveStack {
+private:
+    std::unique_ptr<Move[]> buffer;
+    Move* top;
+    Move* const limit;
+
+public:
+    explicit MoveStack(size_t plies = MAX_PLY) :
+        buffer(std::make_unique<Move[]>(plies * MAX_MOVES)),
+        top(buffer.get()),
+        limit(buffer.get() + plies * MAX_MOVES) {}
+
+    MoveSpan push(const Board& b, Piece p, bool force = false) {
+        assert(limit - top >= MAX_MOVES);
+        Move* const first = top;
+        top = generate(b, first, p, force);
+        return MoveSpan(first, top);
+    }
+
+    void pop(const MoveSpan& span) {
+        assert(span.end() == top);
+        top = span.begin();
+    }
+
+    size_t used() const { return static_cast<size_t>(top - buffer.get()); }
+};
+
 } // namespace Cobra
 
 #endif
\ No newline at end of file
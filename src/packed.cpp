@@ -0,0 +1,103 @@
+#include "packed.hpp"
+#include "board.hpp"
+#include "header.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Cobra {
+
+template<typename W>
+bool PackedState::pack(const BasicState<W>& state, const Piece* next, const size_t count) {
+    static_assert(BasicBoard<W>::ROWS >= ROWS);
+    for (int x = 0; x < COL_NB; ++x) {
+        if constexpr (BasicBoard<W>::ROWS > ROWS)
+            if (state.board[x] >> ROWS)
+                return false;
+        col[x] = static_cast<uint32_t>(state.board[x]);
+    }
+
+    hold = static_cast<uint8_t>(state.hold);
+    b2b = state.b2b;
+    combo = state.combo;
+    queueSize = static_cast<uint8_t>(std::min<size_t>(count, MAX_QUEUE));
+    std::fill(std::begin(queue), std::end(queue), uint8_t(NO_PIECE));
+    for (size_t i = 0; i < queueSize; ++i)
+        queue[i] = static_cast<uint8_t>(next[i]);
+    reserved = 0;
+    return true;
+}
+
+template<typename W>
+void PackedState::unpack(BasicState<W>& state) const {
+    assert(valid());
+    for (int x = 0; x < COL_NB; ++x)
+        state.board[x] = col[x];
+    state.hold = static_cast<Piece>(hold);
+    state.b2b = b2b;
+    state.combo = combo;
+    state.key = state.compute_key();
+}
+
+template bool PackedState::pack(const State&, const Piece*, size_t);
+template bool PackedState::pack(const NarrowState&, const Piece*, size_t);
+template void PackedState::unpack(State&) const;
+template void PackedState::unpack(NarrowState&) const;
+
+bool PackedState::valid() const {
+    if (queueSize > MAX_QUEUE || (hold >= PIECE_NB && hold != NO_PIECE))
+        return false;
+    return std::all_of(queue, queue + queueSize, [](const uint8_t p) { return p < PIECE_NB; });
+}
+
+PackedFile::~PackedFile() {
+    if (mapping)
+        munmap(mapping, bytes);
+}
+
+bool PackedFile::open(const std::string& path) {
+    if (mapping)
+        munmap(mapping, bytes);
+    mapping = nullptr;
+    bytes = 0;
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size <= 0 || st.st_size % sizeof(PackedState)) {
+        close(fd);
+        return false;
+    }
+
+    void* const data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    // Records are read front to back
+    madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    mapping = data;
+    bytes = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+bool write_packed(const std::string& path, const std::vector<PackedState>& records) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(PackedState)));
+    return static_cast<bool>(out);
+}
+
+} // namespace Cobra
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include "board.hpp"
+#include "header.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Cobra {
+
+// Fixed-width State record for position files, read in place from a mapping.
+// Columns keep the low 32 rows, so a taller stack can't be packed, and a
+// NarrowState packs and unpacks without a conversion.
+struct PackedState {
+    static constexpr int ROWS = 32;
+    static constexpr int MAX_QUEUE = 16;
+
+    uint32_t col[COL_NB];
+    uint8_t hold;
+    uint8_t queueSize;
+    int16_t b2b;
+    int16_t combo;
+    uint8_t queue[MAX_QUEUE];
+    uint16_t reserved;
+
+    // Queue pieces past MAX_QUEUE are dropped
+    template<typename W>
+    bool pack(const BasicState<W>& state, const Piece* next, size_t count);
+    template<typename W>
+    void unpack(BasicState<W>& state) const;
+
+    // Whether the hold and queue bytes name pieces, records from a file must be
+    // checked before anything is read from them
+    bool valid() const;
+
+    Piece piece(const size_t i) const {
+        assert(i < queueSize);
+        assert(queue[i] < PIECE_NB);
+        return static_cast<Piece>(queue[i]);
+    }
+};
+
+static_assert(sizeof(PackedState) == 64);
+
+// Read-only mapping of a file of PackedState records
+class PackedFile {
+private:
+    void* mapping = nullptr;
+    size_t bytes = 0;
+
+public:
+    PackedFile() = default;
+    ~PackedFile();
+
+    PackedFile(const PackedFile&) = delete;
+    PackedFile& operator=(const PackedFile&) = delete;
+
+    bool open(const std::string& path);
+
+    const PackedState* begin() const { return static_cast<const PackedState*>(mapping); }
+    const PackedState* end() const { return begin() + size(); }
+    size_t size() const { return bytes / sizeof(PackedState); }
+};
+
+bool write_packed(const std::string& path, const std::vector<PackedState>& records);
+
+} // namespace Cobra
+
+#endif // PACKED_H
\ No newline at end of file
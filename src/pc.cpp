@@ -0,0 +1,153 @@
+#include "pc.hpp"
+#include "board.hpp"
+#include "header.hpp"
+#include "movegen.hpp"
+#include "tt.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Cobra {
+
+namespace PC {
+
+namespace {
+
+// Whether the empty cells between every two filled columns of the bottom height
+// rows are a multiple of 4. A filled column stays filled through line clears, so
+// no piece ever crosses it. Enclosed regions inside a segment are no bound: they
+// merge with the ones above once the rows in between clear.
+bool fillable(const Board& b, const int height) {
+    const Bitboard rows = bb_low(height);
+    int cells = 0;
+    for (int x = 0; x < COL_NB; ++x) {
+        const int empty = height - popcount(b[x] & rows);
+        if (!empty && cells % 4)
+            return false;
+        cells = empty ? cells + empty : 0;
+    }
+    return cells % 4 == 0;
+}
+
+class Solver {
+private:
+    const Piece* const queue;
+    const Piece* const last;
+    const Limits& limits;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    TranspositionTable memo; // Sub-boards without a clear, with the placements it took to find out
+    bool useMemo = false;    // Whether memo could be allocated
+    Solution line;
+    Result result;
+    bool stop = false;
+
+    int64_t elapsed() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Places every move of p inside the rows, putting hold (if any) in the hold slot.
+    // T moves differing only by their spin leave the same board and are tried once.
+    bool play(const State& state, const Piece p, const Piece hold, const Piece* next, const int height) {
+        bool found = false;
+        const MoveList moves(state.board, p);
+        for (const Move* m = moves.begin(); m != moves.end() && !stop; ++m) {
+            const PieceCoordinates pc = m->cells();
+            if (pc[0].y >= height || pc[1].y >= height || pc[2].y >= height || pc[3].y >= height)
+                continue;
+            if (p == T && std::any_of(moves.begin(), m, [m](const Move& o) {
+                    return o.rotation() == m->rotation() && o.x() == m->x() && o.y() == m->y();
+                }))
+                continue;
+
+            State child = state;
+            if (hold != NO_PIECE)
+                child.set_hold(hold);
+            const MoveInfo info = child.do_move(*m);
+            line.push_back(*m);
+
+            if (info.pc) {
+                found = true;
+                result.solutions.push_back(line);
+                stop = limits.solutions && result.solutions.size() >= limits.solutions;
+            }
+            else
+                found |= search(child, next, height - info.clear);
+
+            line.pop_back();
+            if (!(++result.nodes & 1023) && limits.movetime && elapsed() >= limits.movetime)
+                stop = true;
+        }
+        return found;
+    }
+
+    bool search(const State& state, const Piece* next, const int height) {
+        int filled = 0;
+        for (int x = 0; x < COL_NB; ++x)
+            filled += popcount(state.board[x]);
+
+        // Every placement takes a queue piece, the hold one only swaps with it
+        if ((height * COL_NB - filled) / 4 > last - next || !fillable(state.board, height))
+            return false;
+
+        // b2b and combo do not matter to a clear
+        const Key key = state.key ^ Zobrist::b2b(state.b2b) ^ Zobrist::combo(state.combo)
+                      ^ Zobrist::mix(static_cast<Key>((next - queue) * ROW_NB + height));
+        uint64_t nodes;
+        if (useMemo && memo.probe(key, nodes)) {
+            ++result.memoHits;
+            return false;
+        }
+
+        const uint64_t before = result.nodes;
+        const Piece current = *next;
+        bool found = play(state, current, NO_PIECE, next + 1, height);
+        if (limits.hold && !stop) {
+            if (state.hold == NO_PIECE) {
+                if (next + 1 < last)
+                    found |= play(state, next[1], current, next + 2, height);
+            }
+            else if (state.hold != current)
+                found |= play(state, state.hold, current, next + 1, height);
+        }
+
+        if (!found && !stop && useMemo)
+            memo.store(key, std::max<uint64_t>(result.nodes - before, 1));
+        return found;
+    }
+
+public:
+    Solver(const Piece* next, const Piece* l, const Limits& lim) : queue(next), last(l), limits(lim) {
+        // Without the memory the search runs unmemoized, only slower
+        useMemo = limits.hashMb && memo.resize(limits.hashMb);
+    }
+
+    Result run(const State& root) {
+        assert(limits.height > 0 && limits.height < ROW_NB);
+        bool fits = true;
+        for (int x = 0; x < COL_NB; ++x)
+            fits &= !(root.board[x] >> limits.height);
+
+        if (fits && queue != last)
+            search(root, queue, limits.height);
+        result.complete = !stop;
+        result.time = elapsed();
+        return std::move(result);
+    }
+};
+
+} // namespace
+
+Result solve(const State& state, const Piece* next, const Piece* last, const Limits& limits) {
+    assert(next <= last);
+    return Solver(next, last, limits).run(state);
+}
+
+} // namespace PC
+
+} // namespace Cobra
\ No newline at end of file
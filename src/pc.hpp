@@ -0,0 +1,46 @@
+#ifndef PC_H
+#define PC_H
+
+#include "board.hpp"
+#include "header.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Cobra {
+
+namespace PC {
+
+struct Limits {
+    int height = 4;           // Rows the clear has to fit in, every cell above must be empty
+    bool hold = true;
+    size_t solutions = 1;     // Stop after this many, 0 for all of them
+    int64_t movetime = 0;     // Budget in ms, 0 for none
+    size_t hashMb = 16;       // Memo of sub-boards known to fail
+};
+
+// Moves of one perfect clear, in play order. A move of another piece than the
+// queue's next one means that piece came from hold.
+using Solution = std::vector<Move>;
+
+struct Result {
+    std::vector<Solution> solutions;
+    uint64_t nodes = 0;       // Placements tried
+    uint64_t memoHits = 0;
+    bool complete = false;    // Search not cut by the budget or the solution count
+    int64_t time = 0;         // ms
+};
+
+// Perfect clears of the bottom limits.height rows reachable from state with
+// the queue [next, last), holding as perft_hold does. Moves leaving the rows
+// are dropped, and a board is abandoned once the empty cells between two fully
+// filled columns (or a wall) are not a multiple of 4, or the queue and hold can
+// not fill the rows anymore.
+Result solve(const State& state, const Piece* next, const Piece* last, const Limits& limits);
+
+} // namespace PC
+
+} // namespace Cobra
+
+#endif // PC_H
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "reference.hpp"
+#include "board.hpp"
+#include "gen.hpp"
+#include "header.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace Cobra {
+
+namespace {
+
+struct Node {
+    int x, y;
+    Rotation r;
+    SpinType spin;
+};
+
+bool fits(const Board& b, const Piece p, const int x, const int y, const Rotation r) {
+    const PieceCoordinates pc = piece_table(p, r);
+    for (size_t i = 0; i < 4; ++i)
+        if (b.obstructed(x + pc[i].x, y + pc[i].y))
+            return false;
+    return true;
+}
+
+// TETR.IO rules for a T that got to (x, y) by a rotation using kick i
+SpinType spin_type(const Board& b, const int x, const int y, const Rotation r, const size_t kick) {
+    // Corners in front of the flat side first, clockwise from the front left
+    const Coordinates corners[ROTATION_NB] = {{-1, 1}, {1, 1}, {1, -1}, {-1, -1}};
+    bool filled[ROTATION_NB];
+    int count = 0;
+    for (int i = 0; i < ROTATION_NB; ++i)
+        count += filled[i] = b.obstructed(x + corners[i].x, y + corners[i].y);
+
+    if (count < 3)
+        return NO_SPIN;
+    if (kick >= 4 || (filled[r] && filled[(r + 1) & 3]))
+        return FULL;
+    return MINI;
+}
+
+// The Move a generator reports for a real position: I, S and Z keep two
+// rotations, so the other two are expressed through their cell-equal twin
+Move to_move(const Piece p, const Node& n) {
+    Rotation r = n.r;
+    int x = n.x, y = n.y;
+    if ((p == I || p == S || p == Z) && r >= SOUTH) {
+        const Rotation twin = static_cast<Rotation>(r & 1);
+        auto min_corner = [](const PieceCoordinates& pc) {
+            Coordinates m = pc[0];
+            for (size_t i = 1; i < 4; ++i) {
+                m.x = std::min(m.x, pc[i].x);
+                m.y = std::min(m.y, pc[i].y);
+            }
+            return m;
+        };
+        const Coordinates d = min_corner(piece_table(p, r)) - min_corner(piece_table(p, twin));
+        r = twin;
+        x += d.x;
+        y += d.y;
+    }
+    if (p == T && n.spin != NO_SPIN)
+        return Move(TSPIN, r, x, y, n.spin == FULL);
+    return Move(p, r, x, y);
+}
+
+} // namespace
+
+Move* generate_reference(const Board& b, Move* moves, const Piece p, const bool force) {
+    assert(is_ok(p));
+
+    bool visited[ROW_NB][COL_NB][ROTATION_NB][SPIN_NB] = {};
+    std::vector<Node> queue;
+
+    auto push = [&](const Node& n) {
+        if (!visited[n.y][n.x][n.r][n.spin]) {
+            visited[n.y][n.x][n.r][n.spin] = true;
+            queue.push_back(n);
+        }
+    };
+
+    int spawnY = Gen::SPAWN_ROW;
+    if (!fits(b, p, Gen::SPAWN_COL, spawnY, NORTH)) {
+        if (!force)
+            return moves;
+        while (spawnY < ROW_NB && !fits(b, p, Gen::SPAWN_COL, spawnY, NORTH))
+            ++spawnY;
+        if (spawnY == ROW_NB)
+            return moves;
+    }
+    push({Gen::SPAWN_COL, spawnY, NORTH, NO_SPIN});
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const Node n = queue[head];
+
+        for (const int dx : {-1, 1})
+            if (fits(b, p, n.x + dx, n.y, n.r))
+                push({n.x + dx, n.y, n.r, NO_SPIN});
+
+        if (fits(b, p, n.x, n.y - 1, n.r))
+            push({n.x, n.y - 1, n.r, NO_SPIN});
+
+        if (p == O)
+            continue;
+
+        auto rotate = [&](const Rotation r1, const auto& kicks) {
+            for (size_t i = 0; i < kicks.size(); ++i) {
+                const int x1 = n.x + kicks[i].x;
+                const int y1 = n.y + kicks[i].y;
+                if (fits(b, p, x1, y1, r1)) {
+                    push({x1, y1, r1, p == T ? spin_type(b, x1, y1, r1, i) : NO_SPIN});
+                    return;
+                }
+            }
+        };
+        rotate(Gen::rotate<Gen::CW>(n.r), Gen::kicks[p == I][Gen::CW][n.r]);
+        rotate(Gen::rotate<Gen::CCW>(n.r), Gen::kicks[p == I][Gen::CCW][n.r]);
+        rotate(Gen::rotate<Gen::FLIP>(n.r), Gen::kicks180[p == I][n.r]);
+    }
+
+    // A resting position is reported once per way of getting there, duplicates
+    // from the cell-equal rotations of I, S and Z included only once
+    Move* const first = moves;
+    for (const Node& n : queue) {
+        if (fits(b, p, n.x, n.y - 1, n.r))
+            continue;
+        const Move m = to_move(p, n);
+        bool seen = false;
+        for (const Move* o = first; o != moves && !seen; ++o)
+            seen = *o == m;
+        if (!seen)
+            *moves++ = m;
+    }
+    return moves;
+}
+
+} // namespace Cobra
\ No newline at end of file
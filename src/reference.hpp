@@ -0,0 +1,17 @@
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+#include "board.hpp"
+#include "header.hpp"
+
+namespace Cobra {
+
+// Slow breadth-first search over real (x, y, rotation, last spin) states,
+// moving and kicking the piece cell by cell with the SRS+ tables. It shares
+// nothing with the bitboard generators but the tables and the Move encoding,
+// and serves as the oracle for them.
+Move* generate_reference(const Board& b, Move* moves, Piece p, bool force);
+
+} // namespace Cobra
+
+#endif // REFERENCE_H
\ No newline at end of file
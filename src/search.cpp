@@ -0,0 +1,218 @@
+#include "search.hpp"
+#include "board.hpp"
+#include "header.hpp"
+#include "movegen.hpp"
+#include "thread.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace Cobra {
+
+namespace Search {
+
+namespace {
+
+struct Node {
+    State state;
+    int score;
+    int sent;
+    uint32_t next; // Index of the first queue piece left
+    Move root;
+};
+
+// Where a child sits in the per-thread buffers, sorted instead of the Node itself
+struct Entry {
+    Key key;
+    int score;
+    unsigned root; // order() of the root move
+    uint16_t thread;
+    uint32_t index;
+};
+
+unsigned order(const Move& m) {
+    return static_cast<unsigned>(m.x()) << 16 | static_cast<unsigned>(m.y()) << 8
+         | static_cast<unsigned>(m.rotation()) << 6 | static_cast<unsigned>(m.piece()) << 2 | m.spin();
+}
+
+// Better first; equal children are ordered by key and root move so the beam is
+// the same whatever the thread count
+bool better(const Entry& a, const Entry& b) {
+    if (a.score != b.score)
+        return a.score > b.score;
+    if (a.key != b.key)
+        return a.key < b.key;
+    return a.root < b.root;
+}
+
+class Beam {
+private:
+    const Piece* const queue;
+    const uint32_t size;
+    const Limits& limits;
+    const Evaluation eval;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::atomic<uint64_t> nodes{0};
+    std::atomic<bool> stop{false};
+
+    // Appends the children of node to out, holding as perft_hold does: into an
+    // empty slot the following queue piece is played and consumed as well
+    void expand(const Node& node, std::vector<Node>& out) const {
+        const Piece current = queue[node.next];
+        auto play = [&](const Move& move, const bool held, const uint32_t next) {
+            Node& child = out.emplace_back(node);
+            if (held)
+                child.state.set_hold(current);
+            const MoveInfo info = child.state.do_move(move);
+            child.sent += info.lines_sent();
+            child.score = eval(child.state, child.sent);
+            child.next = next;
+            if (node.root == Move::none())
+                child.root = move;
+        };
+
+        if (!limits.hold) {
+            for (const Move& move : MoveList(node.state.board, current))
+                play(move, false, node.next + 1);
+            return;
+        }
+
+        if (node.state.hold != NO_PIECE) {
+            for (const Move& move : HoldMoveList(node.state.board, current, node.state.hold))
+                play(move, move.piece() != current, node.next + 1);
+            return;
+        }
+
+        const MoveList moves(node.state.board, current);
+        for (const Move& move : moves)
+            play(move, false, node.next + 1);
+        if (moves.empty() || node.next + 1 == size)
+            return;
+        for (const Move& move : MoveList(node.state.board, queue[node.next + 1]))
+            play(move, true, node.next + 2);
+    }
+
+    bool out_of_budget() const {
+        if (limits.nodes && nodes.load(std::memory_order_relaxed) >= limits.nodes)
+            return true;
+        return limits.movetime && elapsed() >= limits.movetime;
+    }
+
+public:
+    Beam(const Piece* next, const Piece* last, const Limits& l, const Evaluation e) :
+        queue(next), size(static_cast<uint32_t>(last - next)), limits(l), eval(e) {}
+
+    int64_t elapsed() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    Result run(const State& root) {
+        assert(limits.width > 0);
+        Result result;
+        if (!size)
+            return result;
+
+        ThreadPool pool(std::max<size_t>(limits.threads, 1));
+        std::vector<std::vector<Node>> scratch(pool.size());
+        std::vector<Node> beam{Node{root, 0, 0, 0, Move::none()}};
+        std::vector<Entry> entries;
+
+        for (unsigned ply = 1; ply <= limits.depth && !beam.empty(); ++ply) {
+            for (auto& s : scratch)
+                s.clear();
+
+            // A few chunks per thread so stealing evens out the uneven expansions
+            const size_t chunk = std::max<size_t>(1, beam.size() / (pool.size() * 8));
+            for (size_t first = 0; first < beam.size(); first += chunk)
+                pool.submit([&, first, ply](const size_t id) {
+                    const size_t end = std::min(first + chunk, beam.size());
+                    for (size_t i = first; i < end; ++i) {
+                        if (ply > 1 && stop.load(std::memory_order_relaxed))
+                            return;
+                        if (beam[i].next == size)
+                            continue;
+                        const size_t before = scratch[id].size();
+                        expand(beam[i], scratch[id]);
+                        nodes.fetch_add(scratch[id].size() - before, std::memory_order_relaxed);
+                        if (out_of_budget())
+                            stop.store(true, std::memory_order_relaxed);
+                    }
+                });
+            pool.wait();
+
+            if (ply > 1 && stop.load(std::memory_order_relaxed))
+                break;
+
+            // Transpositions keep their best child, then the width best survive
+            entries.clear();
+            for (size_t t = 0; t < scratch.size(); ++t)
+                for (size_t i = 0; i < scratch[t].size(); ++i) {
+                    const Node& n = scratch[t][i];
+                    entries.push_back({n.state.key ^ Zobrist::mix(n.next), n.score, order(n.root),
+                                       static_cast<uint16_t>(t), static_cast<uint32_t>(i)});
+                }
+            std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+                return a.key != b.key ? a.key < b.key : better(a, b);
+            });
+            entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+                return a.key == b.key;
+            }), entries.end());
+            if (entries.empty())
+                break;
+
+            const size_t kept = std::min<size_t>(limits.width, entries.size());
+            std::partial_sort(entries.begin(), entries.begin() + static_cast<std::ptrdiff_t>(kept), entries.end(), better);
+
+            beam.clear();
+            for (size_t i = 0; i < kept; ++i)
+                beam.push_back(scratch[entries[i].thread][entries[i].index]);
+
+            result.move = beam[0].root;
+            result.score = beam[0].score;
+            result.sent = beam[0].sent;
+            result.depth = ply;
+
+            if (stop.load(std::memory_order_relaxed))
+                break;
+        }
+
+        result.nodes = nodes.load(std::memory_order_relaxed);
+        result.time = elapsed();
+        return result;
+    }
+};
+
+} // namespace
+
+int evaluate(const State& state, const int sent) {
+    int heights[COL_NB];
+    int holes = 0;
+    for (int x = 0; x < COL_NB; ++x) {
+        heights[x] = bitlen(state.board[x]);
+        holes += heights[x] - popcount(state.board[x]);
+    }
+
+    int bumpiness = 0;
+    for (int x = 0; x + 1 < COL_NB; ++x)
+        bumpiness += std::abs(heights[x] - heights[x + 1]);
+
+    const int height = *std::max_element(heights, heights + COL_NB);
+    return 64 * sent + 8 * std::min<int>(state.b2b, 4)
+         - 32 * holes - 4 * bumpiness - 2 * height - 32 * std::max(height - 14, 0);
+}
+
+Result search(const State& root, const Piece* next, const Piece* last, const Limits& limits, const Evaluation eval) {
+    assert(next <= last);
+    return Beam(next, last, limits, eval).run(root);
+}
+
+} // namespace Search
+
+} // namespace Cobra
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "board.hpp"
+#include "header.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Cobra {
+
+namespace Search {
+
+// Score of a beam node, higher is better. sent is the attack of the moves
+// leading to state, summed with MoveInfo::lines_sent.
+using Evaluation = int (*)(const State& state, int sent);
+
+// Attack first, then holes, bumpiness and stack height
+int evaluate(const State& state, int sent);
+
+struct Limits {
+    unsigned width = 256;  // Nodes kept per ply
+    unsigned depth = 7;    // Plies, the queue may end the search first
+    size_t threads = 1;
+    bool hold = false;
+    uint64_t nodes = 0;    // Budget of evaluated children, 0 for none
+    int64_t movetime = 0;  // Budget in ms, 0 for none
+};
+
+struct Result {
+    Move move = Move::none(); // Best root move, of the hold piece if it differs from the current one
+    int score = 0;
+    int sent = 0;             // Attack along the best line
+    unsigned depth = 0;       // Plies completed within the budget
+    uint64_t nodes = 0;       // Children evaluated
+    int64_t time = 0;         // ms
+};
+
+// Beam search over the queue [next, last): every ply expands the kept nodes on
+// limits.threads threads, merges transpositions and keeps the limits.width best
+// children. The first ply always completes; a ply cut by the budget is dropped
+// and the best node of the previous one decides the move.
+Result search(const State& root, const Piece* next, const Piece* last, const Limits& limits,
+              Evaluation eval = evaluate);
+
+} // namespace Search
+
+} // namespace Cobra
+
+#endif // SEARCH_H
\ No newline at end of file
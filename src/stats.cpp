@@ -0,0 +1,69 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace Cobra {
+
+namespace Stats {
+
+namespace {
+
+constexpr const char* Names[STAT_NB] = {
+    "searches", "slow", "early_exits", "pops", "softdrops",
+    "kicks_tried", "kicks_accepted", "spin_maps", "spin_searches"
+};
+
+std::mutex mutex;
+std::vector<ThreadCounts*> threads; // Live threads
+Counts finished{};                  // Folded in by threads on exit
+
+} // namespace
+
+thread_local ThreadCounts local;
+
+ThreadCounts::ThreadCounts() {
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.push_back(this);
+}
+
+ThreadCounts::~ThreadCounts() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int s = 0; s < STAT_NB; ++s)
+        finished[s] += counts[s].load(std::memory_order_relaxed);
+    threads.erase(std::find(threads.begin(), threads.end(), this));
+}
+
+Counts total() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Counts result = finished;
+    for (const ThreadCounts* t : threads)
+        for (int s = 0; s < STAT_NB; ++s)
+            result[s] += t->counts[s].load(std::memory_order_relaxed);
+    return result;
+}
+
+void reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = {};
+    for (ThreadCounts* t : threads)
+        for (int s = 0; s < STAT_NB; ++s)
+            t->counts[s].store(0, std::memory_order_relaxed);
+}
+
+void print(std::ostream& os, const Counts& counts) {
+    const double searches = static_cast<double>(std::max<uint64_t>(counts[SEARCHES], 1));
+    for (int s = 0; s < STAT_NB; ++s) {
+        os << (s ? " " : "") << Names[s] << " " << counts[s];
+        if (s != SEARCHES)
+            os << " (" << static_cast<double>(counts[s]) / searches << "/search)";
+    }
+    os << std::endl;
+}
+
+} // namespace Stats
+
+} // namespace Cobra
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace Cobra {
+
+#ifdef USE_STATS
+constexpr bool STATS = true;
+#else
+constexpr bool STATS = false;
+#endif
+
+enum Stat {
+    SEARCHES,       // generate() and count_moves() calls
+    SLOW_SEARCHES,  // Searches from the spawn, past the surface
+    EARLY_EXITS,    // Searches that ended on total == 0 after the surface
+    POPS,           // (x, rotation) pairs taken from remaining
+    SOFTDROPS,      // Softdrop loop iterations
+    KICKS_TRIED,
+    KICKS_ACCEPTED, // Kicks that moved at least one position
+    SPIN_MAPS,      // SpinMaps built for a T
+    SPIN_SEARCHES,  // T searches on the TSPIN path
+    STAT_NB
+};
+
+namespace Stats {
+
+using Counts = std::array<uint64_t, STAT_NB>;
+
+// Counters of the calling thread. Only the owner writes them, so a relaxed
+// load and store is enough and keeps the increment a plain add.
+struct ThreadCounts {
+    std::atomic<uint64_t> counts[STAT_NB] = {};
+
+    ThreadCounts();
+    ~ThreadCounts();
+};
+
+extern thread_local ThreadCounts local;
+
+// Compiles to nothing unless built with stats=yes
+inline void add([[maybe_unused]] const Stat s, [[maybe_unused]] const uint64_t n = 1) {
+    if constexpr (STATS) {
+        std::atomic<uint64_t>& c = local.counts[s];
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+}
+
+// Sum over every thread, finished ones included
+Counts total();
+void reset();
+void print(std::ostream& os, const Counts& counts);
+
+} // namespace Stats
+
+} // namespace Cobra
+
+#endif // STATS_H
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "thread.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace Cobra {
+
+ThreadPool::ThreadPool(const size_t threadCount) {
+    assert(threadCount > 0);
+    for (size_t i = 0; i < threadCount; ++i)
+        workers.push_back(std::make_unique<Worker>());
+    for (size_t i = 0; i < threadCount; ++i)
+        threads.emplace_back(&ThreadPool::idle_loop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    workCv.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+size_t ThreadPool::default_threads() {
+    const unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+void ThreadPool::submit(Task task) {
+    submit(nextWorker.fetch_add(1, std::memory_order_relaxed) % size(), std::move(task));
+}
+
+void ThreadPool::submit(const size_t id, Task task) {
+    assert(id < size());
+    pending.fetch_add(1, std::memory_order_relaxed);
+    {
+        // Taking the pool mutex orders the increment against a worker about to sleep
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.fetch_add(1, std::memory_order_release);
+    }
+    {
+        std::lock_guard<std::mutex> lock(workers[id]->mutex);
+        workers[id]->tasks.push_back(std::move(task));
+    }
+    workCv.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCv.wait(lock, [&]{ return pending.load(std::memory_order_acquire) == 0; });
+}
+
+bool ThreadPool::pop(const size_t id, Task& task) {
+    {
+        Worker& own = *workers[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < size(); ++i) {
+        Worker& victim = *workers[(id + i) % size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::idle_loop(const size_t id) {
+    Task task;
+    while (true) {
+        if (queued.load(std::memory_order_acquire) && pop(id, task)) {
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            task(id);
+            task = nullptr;
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(mutex);
+                doneCv.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        workCv.wait(lock, [&]{ return stop || queued.load(std::memory_order_acquire); });
+        if (stop)
+            return;
+    }
+}
+
+} // namespace Cobra
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Cobra {
+
+// Work-stealing pool: every worker owns a deque, pops its own tasks from the
+// back and steals from the front of the other deques when it runs dry.
+class ThreadPool {
+public:
+    using Task = std::function<void(size_t)>; // Called with the worker index
+
+    explicit ThreadPool(size_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(Task task);
+    void submit(size_t id, Task task);
+    void wait();
+
+    size_t size() const { return workers.size(); }
+
+    static size_t default_threads();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool pop(size_t id, Task& task);
+    void idle_loop(size_t id);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable workCv;
+    std::condition_variable doneCv;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> nextWorker{0};
+    bool stop = false;
+};
+
+} // namespace Cobra
+
+#endif // THREAD_H
\ No newline at end of file
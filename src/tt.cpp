@@ -0,0 +1,65 @@
+#include "tt.hpp"
+#include "header.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace Cobra {
+
+TranspositionTable::~TranspositionTable() {
+    std::free(table);
+}
+
+bool TranspositionTable::resize(const size_t mb) {
+    std::free(table);
+    clusterCount = mb * 1024 * 1024 / sizeof(TTCluster);
+    table = clusterCount ? static_cast<TTCluster*>(std::aligned_alloc(alignof(TTCluster), clusterCount * sizeof(TTCluster))) : nullptr;
+    if (!table)
+        clusterCount = 0;
+    clear();
+    return table || !mb;
+}
+
+void TranspositionTable::clear() {
+    if (table)
+        std::memset(static_cast<void*>(table), 0, clusterCount * sizeof(TTCluster));
+}
+
+bool TranspositionTable::probe(const Key key, uint64_t& nodes) const {
+    assert(table);
+    for (const auto& e : cluster(key).entry) {
+        const uint64_t n = e.nodes.load(std::memory_order_relaxed);
+        if ((e.check.load(std::memory_order_relaxed) ^ n) == key && n) {
+            nodes = n;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::store(const Key key, const uint64_t nodes) {
+    assert(table);
+    TTEntry* replace = nullptr;
+    uint64_t cheapest = UINT64_MAX;
+    for (auto& e : cluster(key).entry) {
+        const uint64_t n = e.nodes.load(std::memory_order_relaxed);
+        if ((e.check.load(std::memory_order_relaxed) ^ n) == key) {
+            replace = &e;
+            break;
+        }
+        // Keep the larger subtrees, they are the expensive ones to recount
+        if (n < cheapest) {
+            cheapest = n;
+            replace = &e;
+        }
+    }
+
+    replace->check.store(key ^ nodes, std::memory_order_relaxed);
+    replace->nodes.store(nodes, std::memory_order_relaxed);
+}
+
+} // namespace Cobra
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef TT_H
+#define TT_H
+
+#include "header.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Cobra {
+
+// Entries are stored lockless: the key is saved xored with the data, so a torn
+// write from another thread fails verification instead of returning bad counts.
+struct TTEntry {
+    std::atomic<Key> check;
+    std::atomic<uint64_t> nodes;
+};
+
+constexpr size_t CLUSTER_SIZE = 4;
+
+struct alignas(64) TTCluster {
+    TTEntry entry[CLUSTER_SIZE];
+};
+
+static_assert(sizeof(TTCluster) == 64);
+
+class TranspositionTable {
+private:
+    TTCluster* table = nullptr;
+    size_t clusterCount = 0;
+
+    TTCluster& cluster(const Key key) const {
+        // Multiply-shift maps the key onto [0, clusterCount) without a division
+        return table[(static_cast<unsigned __int128>(key) * clusterCount) >> 64];
+    }
+
+public:
+    TranspositionTable() = default;
+    ~TranspositionTable();
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    // False if the table couldn't be allocated, it is left empty then
+    bool resize(size_t mb);
+    void clear();
+
+    bool probe(Key key, uint64_t& nodes) const;
+    void store(Key key, uint64_t nodes);
+
+    size_t size() const { return clusterCount * CLUSTER_SIZE; }
+};
+
+} // namespace Cobra
+
+#endif // TT_H
\ No newline at end of file